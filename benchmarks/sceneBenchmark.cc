@@ -0,0 +1,311 @@
+// Renders a generated scene and measures how fast each kind of ray is traced through it.
+// The scene has a floor, a tessellated sphere of the requested number of triangles, random
+// mirror, glass and diffuse spheres around it, and a ring of lights above. Results are
+// printed as JSON so runs of different versions can be compared.
+#include "../environment/environment.h"
+#include "../renderer/framebuffer.h"
+#include "../renderer/renderOptions.h"
+#include "../renderer/parallelRenderer.h"
+#include "../renderer/renderContext.h"
+#include "../renderer/shading.h"
+#include "../sceneObjects/sphere.h"
+#include <Eigen/Dense>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/resource.h>
+
+using namespace std;
+using namespace Eigen;
+
+class BenchmarkOptions {
+  public:
+    int spheres = 100;
+    int triangles = 100000;
+    int lights = 4;
+    int depth = 3;
+    int resolution = 256;
+    unsigned seed = 410;
+    string outputFile;
+};
+
+// Rays of one kind, traced one after another on a single thread
+class RayTiming {
+  public:
+    long rays = 0;
+    double seconds = 0;
+
+    double raysPerSecond() const { return seconds > 0 ? rays / seconds : 0; }
+};
+
+string benchmarkUsage(const string &program) {
+    return "Usage: " + program + " [--spheres N] [--triangles N] [--lights N] [--depth N] [--resolution N] [--seed N] [--output FILE]\n";
+}
+
+BenchmarkOptions parseBenchmarkOptions(int argc, char **argv) {
+    BenchmarkOptions options;
+    for(int i = 1; i < argc; i++) {
+        const string arg(argv[i]);
+        if(i + 1 >= argc) {
+            throw string("Option " + arg + " is missing its value");
+        }
+        const string value(argv[++i]);
+        if(arg == "--output") {
+            options.outputFile = value;
+            continue;
+        }
+        char *end;
+        long parsed = strtol(value.c_str(), &end, 10);
+        if(value.empty() || *end != '\0' || parsed < 0) {
+            throw string("Option " + arg + " expects a non-negative integer, got \"" + value + "\"");
+        }
+        if(arg == "--spheres")
+            options.spheres = parsed;
+        else if(arg == "--triangles")
+            options.triangles = parsed;
+        else if(arg == "--lights")
+            options.lights = parsed;
+        else if(arg == "--depth")
+            options.depth = parsed;
+        else if(arg == "--resolution" && parsed > 0)
+            options.resolution = parsed;
+        else if(arg == "--seed")
+            options.seed = parsed;
+        else
+            throw string("Unknown option " + arg + " " + value);
+    }
+    return options;
+}
+
+// Unit sphere of rings by 2*rings quads, each split into two triangles, with a shiny material
+int writeSphereMesh(const string &objFile, const string &mtlFile, int triangles) {
+    ofstream mtl(mtlFile);
+    mtl << "newmtl shiny\nNs 64\nKa 0.1 0.1 0.1\nKd 0.6 0.5 0.3\nKs 0.4 0.4 0.4\nillum 3\n";
+    int rings = max(2, (int)round(sqrt(triangles / 4.0)));
+    int segments = 2*rings;
+    ofstream obj(objFile);
+    obj << setprecision(9) << "mtllib " << mtlFile << "\nusemtl shiny\n";
+    for(int ring = 0; ring <= rings; ring++) {
+        double theta = M_PI*ring/rings;
+        for(int segment = 0; segment < segments; segment++) {
+            double phi = 2*M_PI*segment/segments;
+            obj << "v " << sin(theta)*cos(phi) << ' ' << cos(theta) << ' ' << sin(theta)*sin(phi) << '\n';
+        }
+    }
+    for(int ring = 0; ring < rings; ring++) {
+        for(int segment = 0; segment < segments; segment++) {
+            int a = ring*segments + segment + 1;
+            int b = ring*segments + (segment + 1) % segments + 1;
+            obj << "f " << a << ' ' << a + segments << ' ' << b + segments << '\n'
+                << "f " << a << ' ' << b + segments << ' ' << b << '\n';
+        }
+    }
+    return 2*rings*segments;
+}
+
+void writeDriverFile(const string &driverFile, const string &objFile, const BenchmarkOptions &options) {
+    mt19937 generator(options.seed);
+    uniform_real_distribution<double> unit(0.0, 1.0);
+    ofstream driver(driverFile);
+    driver << setprecision(9)
+           << "recursionlevel " << options.depth << "\n"
+           << "eye 0 3 12\nlook 0 0 0\nup 0 1 0\nd -4\nbounds -2 2 -2 2\n"
+           << "res " << options.resolution << ' ' << options.resolution << "\n"
+           << "ambient 0.2 0.2 0.2\n";
+    for(int light = 0; light < options.lights; light++) {
+        double angle = 2*M_PI*light/options.lights;
+        double brightness = 1.0 / max(1, options.lights);
+        driver << "light " << 6*cos(angle) << " 8 " << 6*sin(angle) << " 1 "
+               << brightness << ' ' << brightness << ' ' << brightness << "\n";
+    }
+    driver << "sphere 0 -10000000001 0 10000000000 0.1 0.1 0.1 0.7 0.7 0.7 0 0 0 0.2 0.2 0.2 0\n"
+           << "model 0 1 0 0 1.5 0 0.5 0 30 " << objFile << "\n";
+    // A third each of mirrors, glass and plain spheres
+    for(int sphere = 0; sphere < options.spheres; sphere++) {
+        double angle = 2*M_PI*unit(generator);
+        double distance = 2.5 + 4*unit(generator);
+        double radius = 0.2 + 0.4*unit(generator);
+        double reflective = sphere % 3 == 0 ? 0.8 : sphere % 3 == 1 ? 0.1 : 0;
+        double refractiveIndex = sphere % 3 == 1 ? 1.5 : 0;
+        driver << "sphere " << distance*cos(angle) << ' ' << radius - 1 + 3*unit(generator) << ' '
+               << distance*sin(angle) << ' ' << radius << " 0.1 0.1 0.1 "
+               << unit(generator) << ' ' << unit(generator) << ' ' << unit(generator) << " 0.3 0.3 0.3 "
+               << reflective << ' ' << reflective << ' ' << reflective << ' ' << refractiveIndex << "\n";
+    }
+}
+
+template<typename Trace>
+RayTiming timeRays(vector<Ray> &rays, Trace trace) {
+    RayTiming timing;
+    auto startTime = chrono::steady_clock::now();
+    for(Ray &ray: rays) {
+        trace(ray);
+    }
+    timing.seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+    timing.rays = rays.size();
+    return timing;
+}
+
+// The rays shading spawns from hits, following the rules of shadeIntersection
+void spawnSecondaryRays(const vector<Ray> &hits, vector<Ray> &reflections, vector<Ray> &refractions) {
+    for(const Ray &hit: hits) {
+        const Material &mat = *hit.material;
+        if(mat.illuminationModel >= 3) {
+            Vector3r reflectionDir = -hit.dir;
+            if(reflectionDir.dot(hit.surfaceNormal) >= 0.1 || dynamic_cast<const Sphere *>(hit.intersectObject)) {
+                Ray reflect;
+                reflect.dir = (2*reflectionDir.dot(hit.surfaceNormal)*hit.surfaceNormal - reflectionDir).normalized();
+                reflect.origin = hit.intersect;
+                reflections.push_back(reflect);
+            }
+        }
+        if(mat.illuminationModel >= 6 && mat.refractiveIndex > 0.0001) {
+            try {
+                Ray incoming = hit;
+                refractions.push_back(hit.intersectObject->getRefractionRay(incoming));
+            } catch(string) {}
+        }
+    }
+}
+
+void keepHits(const vector<Ray> &rays, vector<Ray> &hits) {
+    for(const Ray &ray: rays) {
+        if(ray.foundIntersect) hits.push_back(ray);
+    }
+}
+
+void writeTiming(ostream &json, const string &name, const RayTiming &timing, bool last = false) {
+    json << "    \"" << name << "\": {\"rays\": " << timing.rays << ", \"seconds\": " << timing.seconds
+         << ", \"raysPerSecond\": " << timing.raysPerSecond() << "}" << (last ? "\n" : ",\n");
+}
+
+int main(int argc, char **argv) {
+    BenchmarkOptions options;
+    try {
+        options = parseBenchmarkOptions(argc, argv);
+    } catch(string s) {
+        cerr << argv[0] << " Error: " << s << '\n' << benchmarkUsage(argv[0]);
+        return 1;
+    }
+
+    char directoryTemplate[] = "/tmp/raytracer-benchmark-XXXXXX";
+    if(!mkdtemp(directoryTemplate)) {
+        cerr << argv[0] << " Error: Couldn't create a directory for the scene\n";
+        return 1;
+    }
+    string directory(directoryTemplate);
+    string objFile = directory + "/mesh.obj", mtlFile = directory + "/mesh.mtl";
+    string driverFile = directory + "/scene.txt";
+    int meshTriangles = writeSphereMesh(objFile, mtlFile, options.triangles);
+    writeDriverFile(driverFile, objFile, options);
+
+    Environment env;
+    auto loadStart = chrono::steady_clock::now();
+    try {
+        env = Environment(driverFile);
+    } catch(string s) {
+        cerr << argv[0] << " Error: Failed to load the generated scene\n" << s << '\n';
+        return 1;
+    }
+    double loadSeconds = chrono::duration<double>(chrono::steady_clock::now() - loadStart).count();
+    remove(objFile.c_str());
+    remove(mtlFile.c_str());
+    remove(driverFile.c_str());
+    rmdir(directory.c_str());
+
+    // The whole image with the default settings, on every hardware thread
+    RenderOptions renderOptions;
+    Framebuffer image;
+    ParallelRenderer renderer(env, renderOptions);
+    auto renderStart = chrono::steady_clock::now();
+    renderer.render(image, [](double) {});
+    double renderSeconds = chrono::duration<double>(chrono::steady_clock::now() - renderStart).count();
+
+    // Then each kind of ray on its own, so a change to one path shows up in its own number
+    vector<Ray> primaries;
+    for(long y = 0; y < env.yRes; y++) {
+        for(long x = 0; x < env.xRes; x++) {
+            primaries.push_back(primaryRay(x, y, env));
+        }
+    }
+    RayTiming primary = timeRays(primaries, [&](Ray &ray) { env.intersectRay(ray); });
+    vector<Ray> hits, allHits;
+    keepHits(primaries, hits);
+    allHits = hits;
+    RayTiming reflection, refraction;
+    for(int level = 0; level < env.recursionLevel && !hits.empty(); level++) {
+        vector<Ray> reflections, refractions;
+        spawnSecondaryRays(hits, reflections, refractions);
+        RayTiming reflectionLevel = timeRays(reflections, [&](Ray &ray) { env.intersectRay(ray); });
+        RayTiming refractionLevel = timeRays(refractions, [&](Ray &ray) { env.intersectRay(ray); });
+        reflection.rays += reflectionLevel.rays;
+        reflection.seconds += reflectionLevel.seconds;
+        refraction.rays += refractionLevel.rays;
+        refraction.seconds += refractionLevel.seconds;
+        hits.clear();
+        keepHits(reflections, hits);
+        keepHits(refractions, hits);
+        allHits.insert(allHits.end(), hits.begin(), hits.end());
+    }
+    // Shadow rays from every hit to every light in front of the surface, as addLight traces them
+    vector<Ray> shadows;
+    vector<int> shadowLights;
+    for(const Ray &hit: allHits) {
+        for(size_t light = 0; light < env.lightSources.size(); light++) {
+            Vector3r dirToLight = (env.lightSources[light].pos - hit.intersect).normalized();
+            if(dirToLight.dot(hit.surfaceNormal) <= 0) continue;
+            Ray toLight;
+            toLight.origin = hit.intersect + dirToLight*0.00000001;
+            toLight.dir = dirToLight;
+            toLight.foundIntersect = true;
+            toLight.distanceToIntersect = (env.lightSources[light].pos - toLight.origin).norm();
+            shadows.push_back(toLight);
+            shadowLights.push_back(light);
+        }
+    }
+    RenderContext context(env);
+    size_t shadowIndex = 0;
+    long blocked = 0;
+    RayTiming shadow = timeRays(shadows, [&](Ray &ray) {
+        blocked += getShadowCoeff(ray, context, shadowLights[shadowIndex++]) == Vector3r(0,0,0);
+    });
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    ofstream outputFile;
+    if(!options.outputFile.empty()) {
+        outputFile.open(options.outputFile);
+        if(!outputFile) {
+            cerr << argv[0] << " Error: Failed to open output file " << options.outputFile << '\n';
+            return 1;
+        }
+    }
+    ostream &json = options.outputFile.empty() ? cout : outputFile;
+    json << setprecision(6)
+         << "{\n"
+         << "  \"precision\": \"" PRECISION_NAME "\",\n"
+         << "  \"scene\": {\"spheres\": " << options.spheres << ", \"triangles\": " << meshTriangles
+         << ", \"lights\": " << options.lights << ", \"depth\": " << options.depth
+         << ", \"resolution\": " << options.resolution << ", \"seed\": " << options.seed << "},\n"
+         << "  \"loadSeconds\": " << loadSeconds << ",\n"
+         << "  \"renderSeconds\": " << renderSeconds << ",\n"
+         << "  \"renderThreads\": " << renderOptions.threadCount() << ",\n"
+         << "  \"peakRSSMegabytes\": " << usage.ru_maxrss / 1024.0 << ",\n"
+         << "  \"blockedShadowRays\": " << blocked << ",\n"
+         << "  \"rays\": {\n";
+    writeTiming(json, "primary", primary);
+    writeTiming(json, "shadow", shadow);
+    writeTiming(json, "reflection", reflection);
+    writeTiming(json, "refraction", refraction, true);
+    json << "  }\n}\n";
+    return 0;
+}
@@ -0,0 +1,92 @@
+// Measures ray/triangle tests per second for the precomputed TriangleBuffer kernel
+// against the previous approach of gathering the vertices by index and inverting a
+// 3x3 matrix for every face/ray pair.
+#include "../dataStructures/triangleBuffer.h"
+#include <Eigen/Dense>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+
+using namespace std;
+using namespace Eigen;
+
+#define NUM_TRIANGLES 20000
+#define NUM_RAYS 500
+
+class BenchmarkRay {
+  public:
+    Vector3r origin;
+    Vector3r dir;
+};
+
+bool matrixInverseIntersect(const Matrix<Real, 4, Dynamic> &vertices, const Vector3i &face,
+                            const BenchmarkRay &ray, Real &distance) {
+    Vector3r vertex1(vertices(0, face(0)), vertices(1, face(0)), vertices(2, face(0)));
+    Vector3r vertex2(vertices(0, face(1)), vertices(1, face(1)), vertices(2, face(1)));
+    Vector3r vertex3(vertices(0, face(2)), vertices(1, face(2)), vertices(2, face(2)));
+    Matrix3r intersectMatrix;
+    intersectMatrix.col(0) = vertex1 - vertex2;
+    intersectMatrix.col(1) = vertex1 - vertex3;
+    intersectMatrix.col(2) = ray.dir;
+    Vector3r solution = intersectMatrix.inverse() * (vertex1 - ray.origin);
+    distance = solution(2);
+    return distance > 0 && solution(0) > 0 && solution(1) > 0 && solution(0) + solution(1) < 1;
+}
+
+template<typename Test>
+double testsPerSecond(const vector<BenchmarkRay> &rays, int numTriangles, long &hits, Test test) {
+    auto startTime = chrono::steady_clock::now();
+    hits = 0;
+    for(const BenchmarkRay &ray: rays) {
+        for(int i = 0; i < numTriangles; i++) {
+            hits += test(i, ray);
+        }
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+    return rays.size() * 1.0 * numTriangles / seconds;
+}
+
+int main() {
+    mt19937 generator(410);
+    uniform_real_distribution<Real> coordinate(-1.0, 1.0);
+    auto randomPoint = [&]() { return Vector3r(coordinate(generator), coordinate(generator), coordinate(generator)); };
+
+    Matrix<Real, 4, Dynamic> vertices(4, 3*NUM_TRIANGLES);
+    vector<Vector3i> faces;
+    TriangleBuffer triangles;
+    triangles.reserve(NUM_TRIANGLES);
+    for(int i = 0; i < NUM_TRIANGLES; i++) {
+        Vector3r center = randomPoint();
+        Vector3r corners[3];
+        for(int corner = 0; corner < 3; corner++) {
+            corners[corner] = center + 0.2*randomPoint();
+            vertices.col(3*i + corner) << corners[corner], 1;
+        }
+        faces.emplace_back(3*i, 3*i + 1, 3*i + 2);
+        triangles.push_back(corners[0], corners[1], corners[2]);
+    }
+    vector<BenchmarkRay> rays(NUM_RAYS);
+    for(BenchmarkRay &ray: rays) {
+        ray.origin = 3*randomPoint();
+        ray.dir = (randomPoint() - ray.origin).normalized();
+    }
+
+    long inverseHits, bufferHits;
+    double inverseRate = testsPerSecond(rays, NUM_TRIANGLES, inverseHits, [&](int i, const BenchmarkRay &ray) {
+        Real distance;
+        return matrixInverseIntersect(vertices, faces[i], ray, distance);
+    });
+    double bufferRate = testsPerSecond(rays, NUM_TRIANGLES, bufferHits, [&](int i, const BenchmarkRay &ray) {
+        Real distance, beta, gamma;
+        return triangles.intersect(i, ray.origin, ray.dir, distance, beta, gamma);
+    });
+
+    cout << fixed << setprecision(1)
+         << "Triangle tests (" PRECISION_NAME " precision): " << NUM_RAYS << " rays x " << NUM_TRIANGLES << " triangles\n"
+         << "Matrix inverse:  " << inverseRate/1e6 << " million tests/second (" << inverseHits << " hits)\n"
+         << "TriangleBuffer:  " << bufferRate/1e6 << " million tests/second (" << bufferHits << " hits)\n"
+         << "Speedup: " << setprecision(2) << bufferRate/inverseRate << "x\n";
+    return 0;
+}
@@ -0,0 +1,60 @@
+#ifndef BOUNDING_BOX_H
+#define BOUNDING_BOX_H
+
+#include <Eigen/Dense>
+#include "precision.h"
+#include <limits>
+#include <algorithm>
+
+// Axis aligned bounding box, empty until a point or another box is added to it
+class BoundingBox {
+  public:
+    Vector3r min = Vector3r::Constant(std::numeric_limits<Real>::infinity());
+    Vector3r max = Vector3r::Constant(-std::numeric_limits<Real>::infinity());
+
+    void extend(const Vector3r &point) {
+        min = min.cwiseMin(point);
+        max = max.cwiseMax(point);
+    }
+
+    void extend(const BoundingBox &other) {
+        min = min.cwiseMin(other.min);
+        max = max.cwiseMax(other.max);
+    }
+
+    bool isEmpty() const {
+        return min(0) > max(0);
+    }
+
+    Vector3r centroid() const {
+        return (min + max) * 0.5;
+    }
+
+    Real surfaceArea() const {
+        if(isEmpty()) return 0;
+        Vector3r extent = max - min;
+        return 2*(extent(0)*extent(1) + extent(1)*extent(2) + extent(2)*extent(0));
+    }
+
+    int largestAxis() const {
+        Vector3r extent = max - min;
+        if(extent(0) >= extent(1) && extent(0) >= extent(2)) return 0;
+        return extent(1) >= extent(2) ? 1 : 2;
+    }
+
+    // Slab test. On a hit, tNear is the distance at which the ray enters the box, or 0 if it starts inside.
+    bool intersect(const Vector3r &origin, const Vector3r &invDir, Real maxDistance, Real &tNear) const {
+        Real tMin = 0;
+        Real tMax = maxDistance;
+        for(int axis = 0; axis < 3; axis++) {
+            Real t1 = (min(axis) - origin(axis)) * invDir(axis);
+            Real t2 = (max(axis) - origin(axis)) * invDir(axis);
+            tMin = std::max(tMin, std::min(t1, t2));
+            tMax = std::min(tMax, std::max(t1, t2));
+        }
+        tNear = tMin;
+        return tMin <= tMax;
+    }
+};
+
+#endif
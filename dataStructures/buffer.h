@@ -0,0 +1,73 @@
+#ifndef BUFFER_H
+#define BUFFER_H
+
+#include "mappedFile.h"
+#include <vector>
+#include <memory>
+#include <utility>
+#include <cstddef>
+
+// Array of plain values which either owns its elements, while it is being built, or
+// points straight at elements stored in a memory mapped file, which it keeps open.
+// Mapped elements are read only.
+template<typename T>
+class Buffer {
+  public:
+    Buffer() = default;
+    Buffer(const Buffer &other): owned(other.owned), file(other.file) {
+        if(file) {
+            elements = other.elements;
+            count = other.count;
+        } else {
+            refresh();
+        }
+    }
+    Buffer(Buffer &&other): owned(std::move(other.owned)), file(std::move(other.file)),
+                            elements(other.elements), count(other.count) {
+        if(!file) refresh();
+    }
+    Buffer &operator=(Buffer other) {
+        owned.swap(other.owned);
+        file.swap(other.file);
+        elements = other.elements;
+        count = other.count;
+        if(!file) refresh();
+        return *this;
+    }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const T *data() const { return elements; }
+    const T *begin() const { return elements; }
+    const T *end() const { return elements + count; }
+    const T &operator[](size_t index) const { return elements[index]; }
+    // Only while the buffer owns its elements
+    T &operator[](size_t index) { return owned[index]; }
+
+    void reserve(size_t capacity) { owned.reserve(capacity); refresh(); }
+    void clear() { owned.clear(); file.reset(); refresh(); }
+    void push_back(const T &value) { owned.push_back(value); refresh(); }
+    template<typename... Args>
+    void emplace_back(Args&&... args) { owned.emplace_back(std::forward<Args>(args)...); refresh(); }
+
+    // Uses count elements at data, which must stay valid as long as file is open
+    void view(const T *data, size_t size, const std::shared_ptr<const MappedFile> &mapping) {
+        owned = std::vector<T>();
+        file = mapping;
+        elements = data;
+        count = size;
+    }
+
+  private:
+    std::vector<T> owned;
+    std::shared_ptr<const MappedFile> file;
+    const T *elements = nullptr;
+    size_t count = 0;
+
+    void refresh() {
+        elements = owned.data();
+        count = owned.size();
+    }
+};
+
+#endif
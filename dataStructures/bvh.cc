@@ -0,0 +1,173 @@
+#include "bvh.h"
+#include "boundingBox.h"
+#include <Eigen/Dense>
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <limits>
+
+using namespace std;
+using namespace Eigen;
+
+#define BVH_BIN_COUNT 16
+#define BVH_MAX_LEAF_SIZE 4
+// Leaves larger than this are split even if the heuristic claims it isn't worth it
+#define BVH_MAX_SAH_LEAF_SIZE 16
+// Cost of visiting a node relative to a single primitive intersection test
+#define BVH_TRAVERSAL_COST 1.0
+
+class SplitBin {
+  public:
+    BoundingBox bounds;
+    int count = 0;
+};
+
+class BVHSplit {
+  public:
+    int axis = -1;
+    int bin = 0;
+    Real cost = numeric_limits<Real>::infinity();
+};
+
+int binIndex(Real centroid, Real minCentroid, Real extent) {
+    int bin = static_cast<int>(BVH_BIN_COUNT * (centroid - minCentroid) / extent);
+    return max(0, min(BVH_BIN_COUNT - 1, bin));
+}
+
+void BVH::build(const vector<BoundingBox> &primitiveBounds) {
+    nodes.clear();
+    primitiveIndices.resize(primitiveBounds.size());
+    iota(primitiveIndices.begin(), primitiveIndices.end(), 0);
+    if(primitiveBounds.empty()) return;
+    vector<Vector3r> centroids;
+    centroids.reserve(primitiveBounds.size());
+    for(const BoundingBox &box: primitiveBounds) {
+        centroids.push_back(box.centroid());
+    }
+    nodes.reserve(2*primitiveBounds.size());
+    buildRecursive(primitiveBounds, centroids, 0, primitiveBounds.size(), 0);
+}
+
+void BVH::refit(const vector<BoundingBox> &primitiveBounds) {
+    // Children are stored after their parents, so going backwards finishes them first
+    for(int current = int(nodes.size()) - 1; current >= 0; current--) {
+        refitNode(current, primitiveBounds);
+    }
+}
+
+void BVH::refitNodes(const vector<BoundingBox> &primitiveBounds, const vector<int> &nodesToRefit) {
+    for(int current: nodesToRefit) {
+        refitNode(current, primitiveBounds);
+    }
+}
+
+void BVH::refitNode(int current, const vector<BoundingBox> &primitiveBounds) {
+    BVHNode &node = nodes[current];
+    BoundingBox nodeBounds;
+    if(node.isLeaf()) {
+        for(int i = node.firstPrimitive; i < node.firstPrimitive + node.primitiveCount; i++) {
+            nodeBounds.extend(primitiveBounds[primitiveIndices[i]]);
+        }
+    } else {
+        nodeBounds = nodes[current + 1].bounds;
+        nodeBounds.extend(nodes[node.rightChild].bounds);
+    }
+    node.bounds = nodeBounds;
+}
+
+BoundingBox BVH::bounds() const {
+    return nodes.empty() ? BoundingBox() : nodes[0].bounds;
+}
+
+BVHSplit findBestSplit(const vector<BoundingBox> &bounds, const vector<Vector3r> &centroids,
+                       const vector<int> &indices, int first, int count, const BoundingBox &centroidBounds) {
+    BVHSplit best;
+    for(int axis = 0; axis < 3; axis++) {
+        Real minCentroid = centroidBounds.min(axis);
+        Real extent = centroidBounds.max(axis) - minCentroid;
+        if(!(extent > 0)) continue;
+        SplitBin bins[BVH_BIN_COUNT];
+        for(int i = first; i < first + count; i++) {
+            SplitBin &bin = bins[binIndex(centroids[indices[i]](axis), minCentroid, extent)];
+            bin.bounds.extend(bounds[indices[i]]);
+            bin.count++;
+        }
+        // Sweep from the right to find the cost of everything above each split plane
+        Real rightCost[BVH_BIN_COUNT];
+        BoundingBox rightBounds;
+        int rightCount = 0;
+        for(int split = BVH_BIN_COUNT - 1; split > 0; split--) {
+            rightBounds.extend(bins[split].bounds);
+            rightCount += bins[split].count;
+            rightCost[split] = rightCount * rightBounds.surfaceArea();
+        }
+        BoundingBox leftBounds;
+        int leftCount = 0;
+        for(int split = 1; split < BVH_BIN_COUNT; split++) {
+            leftBounds.extend(bins[split-1].bounds);
+            leftCount += bins[split-1].count;
+            if(leftCount == 0 || leftCount == count) continue;
+            Real cost = leftCount * leftBounds.surfaceArea() + rightCost[split];
+            if(cost < best.cost) {
+                best.axis = axis;
+                best.bin = split;
+                best.cost = cost;
+            }
+        }
+    }
+    return best;
+}
+
+int BVH::buildRecursive(const vector<BoundingBox> &bounds, const vector<Vector3r> &centroids,
+                        int first, int count, int depth) {
+    int nodeIndex = nodes.size();
+    nodes.emplace_back();
+    BoundingBox nodeBounds, centroidBounds;
+    for(int i = first; i < first + count; i++) {
+        nodeBounds.extend(bounds[primitiveIndices[i]]);
+        centroidBounds.extend(centroids[primitiveIndices[i]]);
+    }
+    nodes[nodeIndex].bounds = nodeBounds;
+    nodes[nodeIndex].firstPrimitive = first;
+    if(count <= BVH_MAX_LEAF_SIZE) {
+        nodes[nodeIndex].primitiveCount = count;
+        return nodeIndex;
+    }
+
+    auto firstIt = primitiveIndices.begin() + first;
+    auto lastIt = firstIt + count;
+    int axis = centroidBounds.largestAxis();
+    int middle = first + count/2;
+    bool useMedian = depth >= BVH_MAX_DEPTH/2;
+    if(!useMedian) {
+        BVHSplit split = findBestSplit(bounds, centroids, primitiveIndices, first, count, centroidBounds);
+        Real leafCost = count * nodeBounds.surfaceArea();
+        Real splitCost = BVH_TRAVERSAL_COST * nodeBounds.surfaceArea() + split.cost;
+        if(split.axis < 0 || (splitCost >= leafCost && count <= BVH_MAX_SAH_LEAF_SIZE)) {
+            if(count <= BVH_MAX_SAH_LEAF_SIZE) {
+                nodes[nodeIndex].primitiveCount = count;
+                return nodeIndex;
+            }
+            useMedian = true;
+        } else {
+            axis = split.axis;
+            Real minCentroid = centroidBounds.min(axis);
+            Real extent = centroidBounds.max(axis) - minCentroid;
+            middle = partition(firstIt, lastIt, [&](int index) {
+                return binIndex(centroids[index](axis), minCentroid, extent) < split.bin;
+            }) - primitiveIndices.begin();
+        }
+    }
+    if(useMedian) {
+        middle = first + count/2;
+        nth_element(firstIt, primitiveIndices.begin() + middle, lastIt, [&](int a, int b) {
+            return centroids[a](axis) < centroids[b](axis);
+        });
+    }
+
+    nodes[nodeIndex].splitAxis = axis;
+    buildRecursive(bounds, centroids, first, middle - first, depth + 1);
+    int rightChild = buildRecursive(bounds, centroids, middle, first + count - middle, depth + 1);
+    nodes[nodeIndex].rightChild = rightChild;
+    return nodeIndex;
+}
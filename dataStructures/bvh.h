@@ -0,0 +1,169 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "boundingBox.h"
+#include "ray.h"
+#include "rayPacket.h"
+#include "simd.h"
+#include "buffer.h"
+#include "traversalCounters.h"
+#include <Eigen/Dense>
+#include <vector>
+#include <limits>
+
+// Node of a flattened BVH. The left child of an interior node is stored directly after
+// it, so only the right child needs an index. Leaves cover primitiveCount entries of
+// BVH::primitiveIndices starting at firstPrimitive.
+class BVHNode {
+  public:
+    BoundingBox bounds;
+    int rightChild = -1;
+    int firstPrimitive = 0;
+    int primitiveCount = 0;
+    int splitAxis = 0;
+
+    bool isLeaf() const { return primitiveCount > 0; }
+};
+
+// Bounding volume hierarchy built with a binned surface area heuristic
+class BVH {
+  public:
+    Buffer<BVHNode> nodes;
+    // Leaf order of the primitives handed to build(). Callers may reorder their own
+    // primitives to match, so that leaves index straight into them.
+    std::vector<int> primitiveIndices;
+
+    void build(const std::vector<BoundingBox> &primitiveBounds);
+    // Recomputes the bounds of every node from new bounds of the same primitives, keeping
+    // the tree. Much quicker than building it again, but the tree gets worse the further
+    // the primitives move from where they were when it was built.
+    void refit(const std::vector<BoundingBox> &primitiveBounds);
+    // Refits just the given nodes, which must come in decreasing order and include every
+    // ancestor of a node whose primitives moved
+    void refitNodes(const std::vector<BoundingBox> &primitiveBounds, const std::vector<int> &nodesToRefit);
+    BoundingBox bounds() const;
+
+    // Visits the primitives of every leaf the ray passes through, nearest subtree first.
+    // visit(position) receives the position in primitiveIndices and returns true to stop
+    // the traversal. It may shorten the ray, which prunes the remaining subtrees.
+    template<typename Visitor>
+    void traverse(const Ray &ray, Visitor visit) const;
+
+    // Same as traverse, for a packet of rays. A subtree is entered if any ray in the
+    // packet passes through it, and children are ordered by the packet's direction.
+    template<typename Visitor>
+    void traversePacket(const RayPacket &packet, Visitor visit) const;
+
+  private:
+    void refitNode(int current, const std::vector<BoundingBox> &primitiveBounds);
+    int buildRecursive(const std::vector<BoundingBox> &bounds, const std::vector<Vector3r> &centroids,
+                           int first, int count, int depth);
+};
+
+// Subtrees are only skipped if they start this far past the current hit, since the
+// intersection tests accept hits that are within a small tolerance of the closest one.
+#define BVH_DISTANCE_SLACK 0.001
+// Deeper subtrees are split at the median so the traversal stack can't overflow
+#define BVH_MAX_DEPTH 64
+
+template<typename Visitor>
+void BVH::traverse(const Ray &ray, Visitor visit) const {
+    if(nodes.empty()) return;
+    Vector3r invDir = ray.dir.cwiseInverse();
+    Real rootNear;
+    if(!nodes[0].bounds.intersect(ray.origin, invDir, std::numeric_limits<Real>::infinity(), rootNear)) return;
+    int stack[BVH_MAX_DEPTH];
+    Real stackNear[BVH_MAX_DEPTH];
+    int stackSize = 0;
+    int current = 0;
+    TraversalCounters &counters = traversalCounters();
+    while(true) {
+        counters.nodesVisited++;
+        const BVHNode &node = nodes[current];
+        if(node.isLeaf()) {
+            for(int i = node.firstPrimitive; i < node.firstPrimitive + node.primitiveCount; i++) {
+                if(visit(i)) return;
+            }
+        } else {
+            Real maxDistance = ray.foundIntersect ? ray.distanceToIntersect + BVH_DISTANCE_SLACK
+                                                    : std::numeric_limits<Real>::infinity();
+            Real leftNear, rightNear;
+            int left = current + 1;
+            int right = node.rightChild;
+            bool hitLeft = nodes[left].bounds.intersect(ray.origin, invDir, maxDistance, leftNear);
+            bool hitRight = nodes[right].bounds.intersect(ray.origin, invDir, maxDistance, rightNear);
+            if(hitLeft && hitRight) {
+                if(rightNear < leftNear) {
+                    std::swap(left, right);
+                    std::swap(leftNear, rightNear);
+                }
+                stack[stackSize] = right;
+                stackNear[stackSize++] = rightNear;
+                current = left;
+                continue;
+            } else if(hitLeft) {
+                current = left;
+                continue;
+            } else if(hitRight) {
+                current = right;
+                continue;
+            }
+        }
+        // Pop the next subtree that still starts before the closest hit found so far
+        do {
+            if(stackSize == 0) return;
+            current = stack[--stackSize];
+        } while(ray.foundIntersect && stackNear[stackSize] > ray.distanceToIntersect + BVH_DISTANCE_SLACK);
+    }
+}
+
+inline bool packetHitsBox(const BoundingBox &box, const SimdReal origin[3], const SimdReal invDir[3],
+                          SimdReal maxDistance) {
+    SimdReal tMin(0.0);
+    SimdReal tMax = maxDistance;
+    for(int axis = 0; axis < 3; axis++) {
+        SimdReal t1 = (SimdReal(box.min(axis)) - origin[axis]) * invDir[axis];
+        SimdReal t2 = (SimdReal(box.max(axis)) - origin[axis]) * invDir[axis];
+        tMin = max(tMin, min(t1, t2));
+        tMax = min(tMax, max(t1, t2));
+    }
+    return (tMin <= tMax).any();
+}
+
+template<typename Visitor>
+void BVH::traversePacket(const RayPacket &packet, Visitor visit) const {
+    if(nodes.empty()) return;
+    SimdReal origin[3], invDir[3];
+    bool negativeDir[3] = {false, false, false};
+    int leadLane = 0;
+    while(leadLane < SIMD_WIDTH - 1 && !packet.hasRay(leadLane)) leadLane++;
+    for(int axis = 0; axis < 3; axis++) {
+        origin[axis] = packet.originAxis(axis);
+        invDir[axis] = SimdReal(1.0) / packet.dirAxis(axis);
+        negativeDir[axis] = packet.dir[axis][leadLane] < 0;
+    }
+    int stack[BVH_MAX_DEPTH];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+    TraversalCounters &counters = traversalCounters();
+    while(stackSize > 0) {
+        counters.nodesVisited++;
+        int current = stack[--stackSize];
+        const BVHNode &node = nodes[current];
+        SimdReal maxDistance = packet.distances() + SimdReal(BVH_DISTANCE_SLACK);
+        if(!packetHitsBox(node.bounds, origin, invDir, maxDistance)) continue;
+        if(node.isLeaf()) {
+            for(int i = node.firstPrimitive; i < node.firstPrimitive + node.primitiveCount; i++) {
+                visit(i);
+            }
+        } else if(negativeDir[node.splitAxis]) {
+            stack[stackSize++] = current + 1;
+            stack[stackSize++] = node.rightChild;
+        } else {
+            stack[stackSize++] = node.rightChild;
+            stack[stackSize++] = current + 1;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,61 @@
+#include "cacheCounters.h"
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+#include <cstdint>
+#include <initializer_list>
+
+int openCacheCounter(uint64_t event) {
+    perf_event_attr attributes;
+    memset(&attributes, 0, sizeof(attributes));
+    attributes.size = sizeof(attributes);
+    attributes.type = PERF_TYPE_HARDWARE;
+    attributes.config = event;
+    attributes.disabled = 1;
+    // Render threads started later are counted too, and add their counts on exit
+    attributes.inherit = 1;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+    return syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0);
+}
+
+long readCacheCounter(int descriptor) {
+    uint64_t count = 0;
+    if(descriptor < 0 || read(descriptor, &count, sizeof(count)) != sizeof(count)) return 0;
+    return count;
+}
+
+CacheCounters::CacheCounters() {
+    referencesDescriptor = openCacheCounter(PERF_COUNT_HW_CACHE_REFERENCES);
+    missesDescriptor = openCacheCounter(PERF_COUNT_HW_CACHE_MISSES);
+}
+
+CacheCounters::~CacheCounters() {
+    if(referencesDescriptor >= 0) close(referencesDescriptor);
+    if(missesDescriptor >= 0) close(missesDescriptor);
+}
+
+void CacheCounters::start() {
+    if(!available()) return;
+    for(int descriptor: {referencesDescriptor, missesDescriptor}) {
+        ioctl(descriptor, PERF_EVENT_IOC_RESET, 0);
+        ioctl(descriptor, PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+void CacheCounters::stop() {
+    if(!available()) return;
+    for(int descriptor: {referencesDescriptor, missesDescriptor}) {
+        ioctl(descriptor, PERF_EVENT_IOC_DISABLE, 0);
+    }
+}
+
+long CacheCounters::references() const {
+    return available() ? readCacheCounter(referencesDescriptor) : 0;
+}
+
+long CacheCounters::misses() const {
+    return available() ? readCacheCounter(missesDescriptor) : 0;
+}
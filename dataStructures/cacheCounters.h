@@ -0,0 +1,25 @@
+#ifndef CACHE_COUNTERS_H
+#define CACHE_COUNTERS_H
+
+// Hardware counts of cache references and misses in the calling thread and the threads it
+// starts while counting, read through perf_event_open. Virtual machines and containers
+// often don't expose them, in which case available() is false and the counts stay 0.
+class CacheCounters {
+  public:
+    CacheCounters();
+    CacheCounters(const CacheCounters &) = delete;
+    CacheCounters &operator=(const CacheCounters &) = delete;
+    ~CacheCounters();
+
+    bool available() const { return referencesDescriptor >= 0 && missesDescriptor >= 0; }
+    void start();
+    void stop();
+    long references() const;
+    long misses() const;
+
+  private:
+    int referencesDescriptor = -1;
+    int missesDescriptor = -1;
+};
+
+#endif
@@ -0,0 +1,239 @@
+#include "connection.h"
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <cstring>
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Bytes asked for at a time when reading into the buffer. Larger reads go straight into
+// the caller's memory.
+#define CONNECTION_CHUNK_SIZE 65536
+
+Connection::Connection(Connection &&other): descriptor(other.descriptor), buffered(move(other.buffered)) {
+    other.descriptor = -1;
+}
+
+Connection &Connection::operator=(Connection &&other) {
+    if(this != &other) {
+        if(descriptor >= 0) {
+            close(descriptor);
+        }
+        descriptor = other.descriptor;
+        buffered = move(other.buffered);
+        other.descriptor = -1;
+    }
+    return *this;
+}
+
+Connection::~Connection() {
+    if(descriptor >= 0) {
+        close(descriptor);
+    }
+}
+
+bool Connection::receive() {
+    char chunk[CONNECTION_CHUNK_SIZE];
+    while(true) {
+        ssize_t received = recv(descriptor, chunk, sizeof(chunk), 0);
+        if(received < 0 && errno == EINTR) continue;
+        if(received <= 0) return false;
+        buffered.append(chunk, received);
+        return true;
+    }
+}
+
+bool Connection::read(void *data, size_t size) {
+    char *bytes = static_cast<char *>(data);
+    while(size > buffered.size() && size - buffered.size() < CONNECTION_CHUNK_SIZE) {
+        if(!receive()) return false;
+    }
+    size_t fromBuffer = min(size, buffered.size());
+    memcpy(bytes, buffered.data(), fromBuffer);
+    buffered.erase(0, fromBuffer);
+    bytes += fromBuffer;
+    size -= fromBuffer;
+    while(size > 0) {
+        ssize_t received = recv(descriptor, bytes, size, MSG_WAITALL);
+        if(received < 0 && errno == EINTR) continue;
+        if(received <= 0) return false;
+        bytes += received;
+        size -= received;
+    }
+    return true;
+}
+
+bool Connection::write(const void *data, size_t size) {
+    const char *bytes = static_cast<const char *>(data);
+    while(size > 0) {
+        ssize_t sent = send(descriptor, bytes, size, MSG_NOSIGNAL);
+        if(sent < 0 && errno == EINTR) continue;
+        if(sent <= 0) return false;
+        bytes += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+bool Connection::readUint32(uint32_t &value) {
+    uint32_t received;
+    if(!read(&received, sizeof(received))) return false;
+    value = ntohl(received);
+    return true;
+}
+
+bool Connection::readUint32s(uint32_t *values, size_t count) {
+    if(!read(values, count*sizeof(uint32_t))) return false;
+    for(size_t i = 0; i < count; i++) {
+        values[i] = ntohl(values[i]);
+    }
+    return true;
+}
+
+bool Connection::writeUint32s(const uint32_t *values, size_t count) {
+    vector<uint32_t> converted(count);
+    for(size_t i = 0; i < count; i++) {
+        converted[i] = htonl(values[i]);
+    }
+    return write(converted.data(), count*sizeof(uint32_t));
+}
+
+bool Connection::readLine(string &line) {
+    size_t end;
+    while((end = buffered.find('\n')) == string::npos) {
+        if(!receive()) return false;
+    }
+    line = buffered.substr(0, end);
+    buffered.erase(0, end + 1);
+    return true;
+}
+
+void Connection::shutdown() {
+    if(descriptor >= 0) {
+        ::shutdown(descriptor, SHUT_RDWR);
+    }
+}
+
+void Connection::detectDeadPeer(int deadSeconds) {
+    // Three unanswered probes a second apart after being idle for the rest of the time
+    int on = 1, probes = 3, interval = 1, idle = max(1, deadSeconds - probes*interval);
+    setsockopt(descriptor, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on));
+    setsockopt(descriptor, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle));
+    setsockopt(descriptor, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval));
+    setsockopt(descriptor, IPPROTO_TCP, TCP_KEEPCNT, &probes, sizeof(probes));
+    // Keepalive probes wait while sent data is unacknowledged, so bound that as well
+    unsigned int timeout = deadSeconds*1000;
+    setsockopt(descriptor, IPPROTO_TCP, TCP_USER_TIMEOUT, &timeout, sizeof(timeout));
+}
+
+Connection connectTcp(const string &host, int port) {
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *addresses;
+    int error = getaddrinfo(host.c_str(), to_string(port).c_str(), &hints, &addresses);
+    if(error != 0) {
+        throw string("Couldn't look up " + host + ": " + gai_strerror(error));
+    }
+    for(addrinfo *address = addresses; address; address = address->ai_next) {
+        int descriptor = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if(descriptor < 0) continue;
+        if(connect(descriptor, address->ai_addr, address->ai_addrlen) == 0) {
+            freeaddrinfo(addresses);
+            // Small requests shouldn't wait for the acknowledgement of the last write
+            int noDelay = 1;
+            setsockopt(descriptor, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+            return Connection(descriptor);
+        }
+        close(descriptor);
+    }
+    freeaddrinfo(addresses);
+    throw string("Couldn't connect to " + host + " port " + to_string(port));
+}
+
+Listener::Listener(int port) {
+    descriptor = socket(AF_INET, SOCK_STREAM, 0);
+    if(descriptor < 0) {
+        throw string("Couldn't create a socket");
+    }
+    int reuse = 1;
+    setsockopt(descriptor, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    socklen_t length = sizeof(address);
+    if(bind(descriptor, reinterpret_cast<sockaddr *>(&address), length) != 0
+       || listen(descriptor, 64) != 0
+       || getsockname(descriptor, reinterpret_cast<sockaddr *>(&address), &length) != 0) {
+        close(descriptor);
+        throw string("Couldn't listen on port " + to_string(port));
+    }
+    boundPort = ntohs(address.sin_port);
+}
+
+Listener::Listener(const string &socketPath): socketPath(socketPath) {
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(socketPath.empty() || socketPath.size() >= sizeof(address.sun_path)) {
+        throw string("Socket path (" + socketPath + ") is empty or too long");
+    }
+    strcpy(address.sun_path, socketPath.c_str());
+    // A socket left behind by a server which didn't shut down is replaced, but anything
+    // else at the path is somebody's file
+    struct stat status;
+    if(lstat(socketPath.c_str(), &status) == 0) {
+        if(!S_ISSOCK(status.st_mode)) {
+            throw string("Won't listen on " + socketPath + ", which exists and isn't a socket");
+        }
+        unlink(socketPath.c_str());
+    }
+    descriptor = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(descriptor < 0) {
+        throw string("Couldn't create a socket");
+    }
+    if(bind(descriptor, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0
+       || listen(descriptor, 16) != 0) {
+        close(descriptor);
+        throw string("Couldn't listen on socket (" + socketPath + ")");
+    }
+}
+
+Listener::~Listener() {
+    close(descriptor);
+    if(!socketPath.empty()) {
+        unlink(socketPath.c_str());
+    }
+}
+
+Connection Listener::accept(int timeoutMilliseconds) {
+    pollfd waiting;
+    waiting.fd = descriptor;
+    waiting.events = POLLIN;
+    if(poll(&waiting, 1, timeoutMilliseconds) <= 0) {
+        return Connection();
+    }
+    int connection = ::accept(descriptor, nullptr, nullptr);
+    if(connection < 0) {
+        return Connection();
+    }
+    if(socketPath.empty()) {
+        int noDelay = 1;
+        setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    }
+    return Connection(connection);
+}
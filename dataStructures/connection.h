@@ -0,0 +1,72 @@
+#ifndef CONNECTION_H
+#define CONNECTION_H
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+// Stream socket which is closed when it goes out of scope. Reads and writes return false
+// once the other end has gone away, and writing to a closed socket doesn't raise SIGPIPE.
+class Connection {
+  public:
+    Connection() = default;
+    explicit Connection(int descriptor): descriptor(descriptor) {}
+    Connection(Connection &&other);
+    Connection &operator=(Connection &&other);
+    Connection(const Connection &) = delete;
+    Connection &operator=(const Connection &) = delete;
+    ~Connection();
+
+    bool isOpen() const { return descriptor >= 0; }
+    // Waits until size bytes have arrived. Small reads are served from a buffer filled a
+    // chunk at a time, so they don't each cost a system call.
+    bool read(void *data, size_t size);
+    bool write(const void *data, size_t size);
+    // 32-bit values travel in network byte order
+    bool readUint32(uint32_t &value);
+    bool readUint32s(uint32_t *values, size_t count);
+    bool writeUint32s(const uint32_t *values, size_t count);
+    // Reads up to the next newline, which isn't kept in line
+    bool readLine(std::string &line);
+    // Ends the connection in both directions, waking a thread blocked reading from it
+    void shutdown();
+    // Probes a TCP peer which has been quiet for a few seconds, so reads fail within about
+    // deadSeconds of its machine crashing or dropping off the network, which sends nothing
+    // to close the connection
+    void detectDeadPeer(int deadSeconds);
+
+  private:
+    // Receives what has arrived, at least one byte, into buffered
+    bool receive();
+
+    int descriptor = -1;
+    // Received but not read yet
+    std::string buffered;
+};
+
+// Connects to port on host, which may be a name or an address. Throws a string on failure.
+Connection connectTcp(const std::string &host, int port);
+
+// Socket accepting TCP connections on every address of this machine, or connections to a
+// Unix domain socket at a path, which replaces a socket already there and is removed again
+// when the listener goes away. Any other file at the path is left alone. Port 0 picks any free port. Throws a string if it can't listen.
+class Listener {
+  public:
+    explicit Listener(int port);
+    explicit Listener(const std::string &socketPath);
+    Listener(const Listener &) = delete;
+    Listener &operator=(const Listener &) = delete;
+    ~Listener();
+
+    int port() const { return boundPort; }
+    // Waits at most timeoutMilliseconds for a connection, returning one that isn't open
+    // if none came
+    Connection accept(int timeoutMilliseconds);
+
+  private:
+    int descriptor = -1;
+    int boundPort = 0;
+    std::string socketPath;
+};
+
+#endif
@@ -2,12 +2,13 @@
 #define LIGHT_H
 
 #include <Eigen/Dense>
+#include "precision.h"
 
 class Light {
   public:
-    Eigen::Vector3d pos;
+    Vector3r pos;
     bool atInfinity;
-    Eigen::Vector3d color; // r, g, b
+    Vector3r color; // r, g, b
 };
 
 #endif
@@ -0,0 +1,96 @@
+#include "lightTree.h"
+#include "light.h"
+#include "boundingBox.h"
+#include <Eigen/Dense>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+
+using namespace std;
+using namespace Eigen;
+
+void LightTree::build(const vector<Light> &sceneLights) {
+    lights = sceneLights;
+    nodes.clear();
+    if(lights.empty()) return;
+    vector<int> indices(lights.size());
+    iota(indices.begin(), indices.end(), 0);
+    nodes.reserve(2*lights.size());
+    buildRecursive(indices, 0, indices.size());
+}
+
+// Lights are split at the median of the longest axis of their bounds, which keeps the
+// tree balanced whatever their powers
+int LightTree::buildRecursive(vector<int> &indices, int first, int count) {
+    int index = nodes.size();
+    nodes.emplace_back();
+    LightTreeNode node;
+    node.color = Vector3r(0,0,0);
+    for(int i = first; i < first + count; i++) {
+        node.bounds.extend(lights[indices[i]].pos);
+        node.color += lights[indices[i]].color;
+    }
+    node.power = node.color.sum();
+    if(count == 1) {
+        node.light = indices[first];
+    } else {
+        int axis = node.bounds.largestAxis();
+        int half = count / 2;
+        nth_element(indices.begin() + first, indices.begin() + first + half, indices.begin() + first + count,
+                    [&](int a, int b) { return lights[a].pos(axis) < lights[b].pos(axis); });
+        buildRecursive(indices, first, half);
+        node.rightChild = buildRecursive(indices, first + half, count - half);
+    }
+    nodes[index] = node;
+    return index;
+}
+
+Real LightTree::importance(const LightTreeNode &node, const Vector3r &point, const Vector3r &normal) const {
+    // Largest height of the box above the surface's tangent plane
+    Real height = 0;
+    for(int axis = 0; axis < 3; axis++) {
+        height += max(normal(axis)*(node.bounds.min(axis) - point(axis)),
+                      normal(axis)*(node.bounds.max(axis) - point(axis)));
+    }
+    if(height <= 0) return 0;
+    Real distanceSquared = max<Real>((node.bounds.centroid() - point).squaredNorm(),
+                                     max<Real>((node.bounds.max - node.bounds.min).squaredNorm() / 4, 1e-8));
+    // The lights can't be seen at a steeper angle than the top of the box allows
+    Real cosine = min<Real>(1, height / sqrt(distanceSquared));
+    return node.power * cosine / distanceSquared;
+}
+
+bool LightTree::sample(const Vector3r &point, const Vector3r &normal, Random &random,
+                       int &light, Real &probability) const {
+    if(nodes.empty() || importance(nodes[0], point, normal) <= 0) return false;
+    probability = 1;
+    int current = 0;
+    while(!nodes[current].isLeaf()) {
+        int left = current + 1;
+        int right = nodes[current].rightChild;
+        Real leftImportance = importance(nodes[left], point, normal);
+        Real rightImportance = importance(nodes[right], point, normal);
+        Real total = leftImportance + rightImportance;
+        if(total <= 0) return false;
+        Real leftProbability = leftImportance / total;
+        if(random.uniform() < leftProbability) {
+            current = left;
+            probability *= leftProbability;
+        } else {
+            current = right;
+            probability *= 1 - leftProbability;
+        }
+    }
+    light = nodes[current].light;
+    return true;
+}
+
+int LightTree::pickByPower(int current, Random &random) const {
+    while(!nodes[current].isLeaf()) {
+        int left = current + 1;
+        int right = nodes[current].rightChild;
+        Real total = nodes[left].power + nodes[right].power;
+        current = total > 0 && random.uniform()*total >= nodes[left].power ? right : left;
+    }
+    return nodes[current].light;
+}
@@ -0,0 +1,83 @@
+#ifndef LIGHT_TREE_H
+#define LIGHT_TREE_H
+
+#include "light.h"
+#include "boundingBox.h"
+#include "random.h"
+#include <Eigen/Dense>
+#include <vector>
+
+// Node of a flattened light tree. As in the BVH, the left child of an interior node is
+// stored directly after it. Leaves hold a single light.
+class LightTreeNode {
+  public:
+    BoundingBox bounds;
+    // Summed colour of the lights below the node, and its total as a measure of power
+    Vector3r color;
+    Real power;
+    int rightChild = -1;
+    int light = -1;
+
+    bool isLeaf() const { return light >= 0; }
+};
+
+// Hierarchy of the scene's lights by position, used to shade with a few lights picked
+// by how much they can contribute, or with whole clusters of far away lights at once
+class LightTree {
+  public:
+    std::vector<Light> lights;
+    std::vector<LightTreeNode> nodes;
+
+    void build(const std::vector<Light> &sceneLights);
+
+    // Upper bound on what the node's lights can contribute to a point with the given
+    // normal, up to a constant factor. Zero if they are all behind the surface.
+    Real importance(const LightTreeNode &node, const Vector3r &point, const Vector3r &normal) const;
+
+    // Picks a light with probability proportional to the importance of the subtrees it is
+    // in. Returns false if no light can reach the point.
+    bool sample(const Vector3r &point, const Vector3r &normal, Random &random,
+                int &light, Real &probability) const;
+
+    // Calls visit(light, index) with a light standing in for each cluster whose angular size
+    // seen from the point is below threshold, or for single lights nearer than that. A
+    // cluster shines from one of its lights (lights[index]), picked by power, with the
+    // colour of the whole cluster.
+    template<typename Visitor>
+    void forEachCluster(const Vector3r &point, const Vector3r &normal, Real threshold,
+                        Random &random, Visitor visit) const;
+
+  private:
+    int buildRecursive(std::vector<int> &indices, int first, int count);
+    int pickByPower(int node, Random &random) const;
+};
+
+// Trees over more lights than any scene has are still far shallower than this
+#define LIGHT_TREE_MAX_DEPTH 64
+
+template<typename Visitor>
+void LightTree::forEachCluster(const Vector3r &point, const Vector3r &normal, Real threshold,
+                               Random &random, Visitor visit) const {
+    if(nodes.empty()) return;
+    int stack[LIGHT_TREE_MAX_DEPTH];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+    while(stackSize > 0) {
+        int current = stack[--stackSize];
+        const LightTreeNode &node = nodes[current];
+        if(importance(node, point, normal) <= 0) continue;
+        Real size = (node.bounds.max - node.bounds.min).norm();
+        Real distance = (node.bounds.centroid() - point).norm();
+        if(node.isLeaf() || size < threshold*distance) {
+            int light = pickByPower(current, random);
+            Light cluster = lights[light];
+            cluster.color = node.color;
+            visit(cluster, light);
+        } else {
+            stack[stackSize++] = node.rightChild;
+            stack[stackSize++] = current + 1;
+        }
+    }
+}
+
+#endif
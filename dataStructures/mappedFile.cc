@@ -0,0 +1,38 @@
+#include "mappedFile.h"
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+MappedFile::MappedFile(const string &fileName, Access access) {
+    int descriptor = open(fileName.c_str(), O_RDONLY);
+    if(descriptor < 0) {
+        throw ("Couldn't open file (" + fileName + ") for reading");
+    }
+    struct stat status;
+    if(fstat(descriptor, &status) != 0) {
+        close(descriptor);
+        throw ("Couldn't read the size of file (" + fileName + ")");
+    }
+    length = status.st_size;
+    // Mapping an empty file fails, and there is nothing to read anyway
+    if(length > 0) {
+        void *mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if(mapping == MAP_FAILED) {
+            close(descriptor);
+            throw ("Couldn't map file (" + fileName + ") into memory");
+        }
+        madvise(mapping, length, access == Sequential ? MADV_SEQUENTIAL : MADV_WILLNEED);
+        data = static_cast<const char *>(mapping);
+    }
+    close(descriptor);
+}
+
+MappedFile::~MappedFile() {
+    if(data) {
+        munmap(const_cast<char *>(data), length);
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <cstddef>
+
+// Read only view of a whole file mapped into memory. Throws a string if the file
+// can't be opened.
+class MappedFile {
+  public:
+    // How the file will be read, passed on to the kernel. Sequential reads may have
+    // pages behind the reader dropped, while WholeFile pages the file in ahead of use
+    // and keeps it, for files read all over for as long as they are mapped.
+    enum Access { Sequential, WholeFile };
+
+    MappedFile(const std::string &fileName, Access access = Sequential);
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile();
+
+    const char *begin() const { return data; }
+    const char *end() const { return data + length; }
+    size_t size() const { return length; }
+
+  private:
+    const char *data = nullptr;
+    size_t length = 0;
+};
+
+#endif
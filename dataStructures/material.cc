@@ -4,6 +4,7 @@
 #include <string>
 #include <fstream>
 #include <cstdlib>
+#include <iterator>
 
 using namespace boost;
 using namespace Eigen;
@@ -52,19 +53,36 @@ void processTransparency(Material &mat, tokenizer<char_separator<char>>::iterato
     mat.transparency(2) = atof((*it++).c_str());
 }
 
+bool applyMaterialStatement(Material &mat, const string &statement) {
+    char_separator<char> sep(" \n\t\r");
+    tokenizer<char_separator<char>> tokens(statement, sep);
+    auto lineIt = tokens.begin();
+    if(lineIt == tokens.end()) return false;
+    const string type(*lineIt++);
+    size_t values = distance(lineIt, tokens.end());
+    bool colour = type == "Ka" || type == "Kd" || type == "Ks" || type == "Tr";
+    if(values < (colour ? 3u : 1u)) return false;
+    if(type == "Ka") processAmbient(mat, lineIt);
+    else if(type == "Kd") processDiffuse(mat, lineIt);
+    else if(type == "Ks") processSpecular(mat, lineIt);
+    else if(type == "Ns") processExponent(mat, lineIt);
+    else if(type == "Ni") processRefractiveIndex(mat, lineIt);
+    else if(type == "Tr") processTransparency(mat, lineIt);
+    else if(type == "illum") processIllum(mat, lineIt);
+    else return false;
+    return true;
+}
+
 void processMaterialLine(vector<Material> &vecToExtend, const string &line) {
     char_separator<char> sep(" \n\t\r");
     tokenizer<char_separator<char>> tokens(line, sep);
     auto lineIt = tokens.begin();
     const string type(*lineIt++);
-    if(type == "Ka") processAmbient(vecToExtend.back(), lineIt);
-    if(type == "Kd") processDiffuse(vecToExtend.back(), lineIt);
-    if(type == "Ks") processSpecular(vecToExtend.back(), lineIt);
-    if(type == "Ns") processExponent(vecToExtend.back(), lineIt);
-    if(type == "Ni") processRefractiveIndex(vecToExtend.back(), lineIt);
-    if(type == "Tr") processTransparency(vecToExtend.back(), lineIt);
-    if(type == "illum") processIllum(vecToExtend.back(), lineIt);
-    if(type == "newmtl") processNewMat(vecToExtend, lineIt);
+    if(type == "newmtl") {
+        processNewMat(vecToExtend, lineIt);
+    } else if(!vecToExtend.empty()) {
+        applyMaterialStatement(vecToExtend.back(), line);
+    }
 }
 
 void processMaterialFile(vector<Material> &vecToExtend, ifstream &file) {
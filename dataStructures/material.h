@@ -2,22 +2,26 @@
 #define MATERIAL_H
 
 #include <Eigen/Dense>
+#include "precision.h"
 #include <vector>
 #include <string>
 
 class Material {
   public:
-    Eigen::Vector3d ambient = Eigen::Vector3d(0,0,0);
-    Eigen::Vector3d diffuse = Eigen::Vector3d(0,0,0);
-    Eigen::Vector3d specular = Eigen::Vector3d(0,0,0);
-    Eigen::Vector3d reflective = Eigen::Vector3d(0,0,0);
-    double specularExponent = 0;
+    Vector3r ambient = Vector3r(0,0,0);
+    Vector3r diffuse = Vector3r(0,0,0);
+    Vector3r specular = Vector3r(0,0,0);
+    Vector3r reflective = Vector3r(0,0,0);
+    Real specularExponent = 0;
     int illuminationModel = 6;
-    double refractiveIndex = 0;
-    Eigen::Vector3d transparency = Eigen::Vector3d(0,0,0);
+    Real refractiveIndex = 0;
+    Vector3r transparency = Vector3r(0,0,0);
     std::string name;
 };
 
 void materialFactory(std::vector<Material> &vecToExtend, const std::string &file);
+// Applies one statement of a material file, such as "Kd 0.5 0.5 0.5", to material.
+// Returns false for a statement it doesn't know or which is missing values.
+bool applyMaterialStatement(Material &material, const std::string &statement);
 
 #endif
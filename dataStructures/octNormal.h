@@ -0,0 +1,46 @@
+#ifndef OCT_NORMAL_H
+#define OCT_NORMAL_H
+
+#include "precision.h"
+#include <Eigen/Dense>
+#include <cmath>
+#include <algorithm>
+#include <cstdint>
+
+// Unit vectors packed into 32 bits. The vector is projected onto the octahedron
+// |x| + |y| + |z| = 1, whose lower half is folded over the upper half so the whole
+// surface covers the square [-1, 1]^2, and both coordinates are kept as 16 bit
+// fractions. Decoded vectors are within about 0.003 degrees of the original.
+
+inline Real octSign(Real value) {
+    return value >= 0 ? 1 : -1;
+}
+
+inline int16_t octQuantize(Real value) {
+    return int16_t(std::lround(std::max<Real>(-1, std::min<Real>(1, value)) * 32767));
+}
+
+inline uint32_t encodeOctNormal(const Vector3r &normal) {
+    Real length = std::abs(normal(0)) + std::abs(normal(1)) + std::abs(normal(2));
+    Real u = normal(0) / length;
+    Real v = normal(1) / length;
+    if(normal(2) < 0) {
+        Real foldedU = (1 - std::abs(v)) * octSign(u);
+        v = (1 - std::abs(u)) * octSign(v);
+        u = foldedU;
+    }
+    return uint16_t(octQuantize(u)) | uint32_t(uint16_t(octQuantize(v))) << 16;
+}
+
+inline Vector3r decodeOctNormal(uint32_t packed) {
+    Real u = int16_t(packed & 0xffff) / Real(32767);
+    Real v = int16_t(packed >> 16) / Real(32767);
+    Vector3r normal(u, v, 1 - std::abs(u) - std::abs(v));
+    if(normal(2) < 0) {
+        normal(0) = (1 - std::abs(v)) * octSign(u);
+        normal(1) = (1 - std::abs(u)) * octSign(v);
+    }
+    return normal / normal.norm();
+}
+
+#endif
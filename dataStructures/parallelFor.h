@@ -0,0 +1,30 @@
+#ifndef PARALLEL_FOR_H
+#define PARALLEL_FOR_H
+
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+
+// Splits [0, count) into one contiguous range per hardware thread and calls
+// body(begin, end) for every range on its own thread. Counts too small to be worth
+// the threads run on the calling thread.
+template<typename Body>
+void parallelFor(size_t count, Body body, size_t minPerThread = 4096) {
+    size_t numThreads = std::max(1u, std::thread::hardware_concurrency());
+    numThreads = std::min(numThreads, std::max<size_t>(1, count / minPerThread));
+    if(numThreads == 1) {
+        body(size_t(0), count);
+        return;
+    }
+    std::vector<std::thread> workers;
+    for(size_t i = 1; i < numThreads; i++) {
+        workers.emplace_back(body, count*i/numThreads, count*(i + 1)/numThreads);
+    }
+    body(size_t(0), count/numThreads);
+    for(std::thread &worker: workers) {
+        worker.join();
+    }
+}
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef PRECISION_H
+#define PRECISION_H
+
+#include <Eigen/Dense>
+
+// Scalar type used by the whole tracing core. Doubles by default; build with
+// make PRECISION=single (or make raytracer-float) to trace in single precision,
+// which halves the memory traffic of the geometry and doubles the SIMD width.
+#ifdef RAYTRACER_SINGLE_PRECISION
+typedef float Real;
+#define PRECISION_NAME "single"
+#else
+typedef double Real;
+#define PRECISION_NAME "double"
+#endif
+
+typedef Eigen::Matrix<Real, 2, 1> Vector2r;
+typedef Eigen::Matrix<Real, 3, 1> Vector3r;
+typedef Eigen::Matrix<Real, 4, 1> Vector4r;
+typedef Eigen::Matrix<Real, 3, 3> Matrix3r;
+typedef Eigen::Matrix<Real, 4, 4> Matrix4r;
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include "precision.h"
+#include <cstdint>
+
+// Small PCG32 generator. Reseeding is cheap, so renderers can give every pixel its own
+// sequence and get the same image however the pixels are spread over threads.
+class Random {
+  public:
+    Random(uint64_t value = 0) { seed(value); }
+
+    void seed(uint64_t value) {
+        // Splitmix64 scrambles nearby seeds, such as neighbouring pixels, into unrelated states
+        value += 0x9E3779B97F4A7C15ULL;
+        value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+        state = value ^ (value >> 31);
+        next();
+    }
+
+    uint32_t next() {
+        uint64_t old = state;
+        state = old*6364136223846793005ULL + 1442695040888963407ULL;
+        uint32_t shifted = ((old >> 18) ^ old) >> 27;
+        uint32_t rotation = old >> 59;
+        return (shifted >> rotation) | (shifted << ((32 - rotation) & 31));
+    }
+
+    // Uniform in [0, 1), with 24 bits so it stays below 1 in single precision too
+    Real uniform() {
+        return (next() >> 8) * Real(1.0 / 16777216.0);
+    }
+
+  private:
+    uint64_t state;
+};
+
+#endif
@@ -8,19 +8,26 @@
 
 // Using forward declaration to prevent circular dependency
 class SceneObject;
-class Face;
 
 class Ray {
   public:
-    Eigen::Vector3d dir;
-    Eigen::Vector3d origin;
+    Vector3r dir;
+    Vector3r origin;
 
-    Eigen::Vector3d intersect;
+    // Hit record kept up to date while searching for the closest hit. It only says
+    // what was hit, so a closer hit costs a handful of stores.
     bool foundIntersect = false;
-    Eigen::Vector3d surfaceNormal;
-    double distanceToIntersect;
-    Material material;
-    SceneObject *intersectObject;
+    Real distanceToIntersect = 0;
+    const SceneObject *intersectObject = nullptr;
+    int primitiveIndex = -1;
+    // Barycentric weights of the second and third vertex for triangle hits
+    Real beta = 0;
+    Real gamma = 0;
+
+    // Filled in by SceneObject::resolveHit once the closest hit is known
+    Vector3r intersect = Vector3r(0,0,0);
+    Vector3r surfaceNormal = Vector3r(0,0,0);
+    const Material *material = nullptr;
 };
 
 #endif
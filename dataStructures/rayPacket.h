@@ -0,0 +1,55 @@
+#ifndef RAY_PACKET_H
+#define RAY_PACKET_H
+
+#include "simd.h"
+#include "ray.h"
+#include <Eigen/Dense>
+#include <limits>
+
+class SceneObject;
+
+// SIMD_WIDTH coherent rays traced together, stored component by component. A lane without
+// a ray has a distance of -infinity, so it can never accept a hit or enter a bounding box.
+class RayPacket {
+  public:
+    alignas(SIMD_ALIGNMENT) Real origin[3][SIMD_WIDTH];
+    alignas(SIMD_ALIGNMENT) Real dir[3][SIMD_WIDTH];
+    // Distance to the closest hit so far, infinity while nothing has been hit
+    alignas(SIMD_ALIGNMENT) Real distance[SIMD_WIDTH];
+    // Barycentric weights of the second and third vertex for triangle hits
+    alignas(SIMD_ALIGNMENT) Real beta[SIMD_WIDTH];
+    alignas(SIMD_ALIGNMENT) Real gamma[SIMD_WIDTH];
+    const SceneObject *hitObject[SIMD_WIDTH];
+    int hitPrimitive[SIMD_WIDTH];
+
+    RayPacket() {
+        for(int lane = 0; lane < SIMD_WIDTH; lane++) {
+            for(int axis = 0; axis < 3; axis++) {
+                origin[axis][lane] = 0;
+                dir[axis][lane] = 1;
+            }
+            distance[lane] = -std::numeric_limits<Real>::infinity();
+            beta[lane] = gamma[lane] = 0;
+            hitObject[lane] = nullptr;
+            hitPrimitive[lane] = -1;
+        }
+    }
+
+    void setRay(int lane, const Vector3r &rayOrigin, const Vector3r &rayDir) {
+        for(int axis = 0; axis < 3; axis++) {
+            origin[axis][lane] = rayOrigin(axis);
+            dir[axis][lane] = rayDir(axis);
+        }
+        distance[lane] = std::numeric_limits<Real>::infinity();
+    }
+
+    bool hasRay(int lane) const {
+        return distance[lane] != -std::numeric_limits<Real>::infinity();
+    }
+
+    SimdReal originAxis(int axis) const { return SimdReal::load(origin[axis]); }
+    SimdReal dirAxis(int axis) const { return SimdReal::load(dir[axis]); }
+    SimdReal distances() const { return SimdReal::load(distance); }
+};
+
+#endif
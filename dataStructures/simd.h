@@ -0,0 +1,134 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include "precision.h"
+
+// Thin wrapper over the widest vector instructions the compiler was told it may use.
+// Build with e.g. make ARCH_FLAGS=-mavx2 to get 256 bit registers instead of the 128
+// bit ones provided by SSE2, which every x86-64 processor supports. A register holds
+// twice as many lanes in single precision as in double precision.
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define SIMD_REGISTER_BYTES 32
+#define SIMD_INSTRUCTION_SET "AVX"
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SIMD_REGISTER_BYTES 16
+#define SIMD_INSTRUCTION_SET "SSE2"
+#else
+#include <cmath>
+#include <algorithm>
+#define SIMD_REGISTER_BYTES 0
+#define SIMD_INSTRUCTION_SET "scalar"
+#endif
+
+#if SIMD_REGISTER_BYTES == 0
+#define SIMD_WIDTH 1
+#elif defined(RAYTRACER_SINGLE_PRECISION)
+#define SIMD_WIDTH (SIMD_REGISTER_BYTES/4)
+#else
+#define SIMD_WIDTH (SIMD_REGISTER_BYTES/8)
+#endif
+
+#define SIMD_ALIGNMENT (SIMD_WIDTH*sizeof(Real))
+
+// Native register and intrinsics for the configured precision
+#if defined(__AVX__) && defined(RAYTRACER_SINGLE_PRECISION)
+typedef __m256 SimdRegister;
+#define SIMD_OP(name) _mm256_##name##_ps
+#elif defined(__AVX__)
+typedef __m256d SimdRegister;
+#define SIMD_OP(name) _mm256_##name##_pd
+#elif defined(__SSE2__) && defined(RAYTRACER_SINGLE_PRECISION)
+typedef __m128 SimdRegister;
+#define SIMD_OP(name) _mm_##name##_ps
+#elif defined(__SSE2__)
+typedef __m128d SimdRegister;
+#define SIMD_OP(name) _mm_##name##_pd
+#endif
+
+class SimdMask;
+
+// SIMD_WIDTH Reals processed as one value
+class SimdReal {
+  public:
+#if SIMD_REGISTER_BYTES > 0
+    SimdRegister value;
+    SimdReal(SimdRegister value): value(value) {}
+    SimdReal(Real scalar): value(SIMD_OP(set1)(scalar)) {}
+    static SimdReal load(const Real *data) { return SIMD_OP(load)(data); }
+    void store(Real *data) const { SIMD_OP(store)(data, value); }
+#else
+    Real value;
+    SimdReal(Real scalar): value(scalar) {}
+    static SimdReal load(const Real *data) { return *data; }
+    void store(Real *data) const { *data = value; }
+#endif
+    SimdReal() = default;
+};
+
+// Result of a lane by lane comparison
+class SimdMask {
+  public:
+#if SIMD_REGISTER_BYTES > 0
+    SimdRegister value;
+    SimdMask(SimdRegister value): value(value) {}
+    // One bit per lane, lane 0 in the lowest bit
+    int bits() const { return SIMD_OP(movemask)(value); }
+#else
+    bool value;
+    SimdMask(bool value): value(value) {}
+    int bits() const { return value ? 1 : 0; }
+#endif
+    bool any() const { return bits() != 0; }
+};
+
+#if SIMD_REGISTER_BYTES > 0
+inline SimdReal operator+(SimdReal a, SimdReal b) { return SIMD_OP(add)(a.value, b.value); }
+inline SimdReal operator-(SimdReal a, SimdReal b) { return SIMD_OP(sub)(a.value, b.value); }
+inline SimdReal operator*(SimdReal a, SimdReal b) { return SIMD_OP(mul)(a.value, b.value); }
+inline SimdReal operator/(SimdReal a, SimdReal b) { return SIMD_OP(div)(a.value, b.value); }
+inline SimdReal min(SimdReal a, SimdReal b) { return SIMD_OP(min)(a.value, b.value); }
+inline SimdReal max(SimdReal a, SimdReal b) { return SIMD_OP(max)(a.value, b.value); }
+inline SimdReal sqrt(SimdReal a) { return SIMD_OP(sqrt)(a.value); }
+inline SimdMask operator&(SimdMask a, SimdMask b) { return SIMD_OP(and)(a.value, b.value); }
+inline SimdMask operator|(SimdMask a, SimdMask b) { return SIMD_OP(or)(a.value, b.value); }
+#endif
+
+#if defined(__AVX__)
+inline SimdMask operator<(SimdReal a, SimdReal b) { return SIMD_OP(cmp)(a.value, b.value, _CMP_LT_OQ); }
+inline SimdMask operator>(SimdReal a, SimdReal b) { return SIMD_OP(cmp)(a.value, b.value, _CMP_GT_OQ); }
+inline SimdMask operator<=(SimdReal a, SimdReal b) { return SIMD_OP(cmp)(a.value, b.value, _CMP_LE_OQ); }
+inline SimdMask operator>=(SimdReal a, SimdReal b) { return SIMD_OP(cmp)(a.value, b.value, _CMP_GE_OQ); }
+inline SimdMask operator!=(SimdReal a, SimdReal b) { return SIMD_OP(cmp)(a.value, b.value, _CMP_NEQ_UQ); }
+// Lanes of a where the mask is set, lanes of b elsewhere
+inline SimdReal select(SimdMask mask, SimdReal a, SimdReal b) { return SIMD_OP(blendv)(b.value, a.value, mask.value); }
+#elif defined(__SSE2__)
+inline SimdMask operator<(SimdReal a, SimdReal b) { return SIMD_OP(cmplt)(a.value, b.value); }
+inline SimdMask operator>(SimdReal a, SimdReal b) { return SIMD_OP(cmpgt)(a.value, b.value); }
+inline SimdMask operator<=(SimdReal a, SimdReal b) { return SIMD_OP(cmple)(a.value, b.value); }
+inline SimdMask operator>=(SimdReal a, SimdReal b) { return SIMD_OP(cmpge)(a.value, b.value); }
+inline SimdMask operator!=(SimdReal a, SimdReal b) { return SIMD_OP(cmpneq)(a.value, b.value); }
+inline SimdReal select(SimdMask mask, SimdReal a, SimdReal b) {
+    return SIMD_OP(or)(SIMD_OP(and)(mask.value, a.value), SIMD_OP(andnot)(mask.value, b.value));
+}
+#else
+inline SimdReal operator+(SimdReal a, SimdReal b) { return a.value + b.value; }
+inline SimdReal operator-(SimdReal a, SimdReal b) { return a.value - b.value; }
+inline SimdReal operator*(SimdReal a, SimdReal b) { return a.value * b.value; }
+inline SimdReal operator/(SimdReal a, SimdReal b) { return a.value / b.value; }
+inline SimdReal min(SimdReal a, SimdReal b) { return std::min(a.value, b.value); }
+inline SimdReal max(SimdReal a, SimdReal b) { return std::max(a.value, b.value); }
+inline SimdReal sqrt(SimdReal a) { return std::sqrt(a.value); }
+inline SimdMask operator<(SimdReal a, SimdReal b) { return a.value < b.value; }
+inline SimdMask operator>(SimdReal a, SimdReal b) { return a.value > b.value; }
+inline SimdMask operator<=(SimdReal a, SimdReal b) { return a.value <= b.value; }
+inline SimdMask operator>=(SimdReal a, SimdReal b) { return a.value >= b.value; }
+inline SimdMask operator!=(SimdReal a, SimdReal b) { return a.value != b.value; }
+inline SimdMask operator&(SimdMask a, SimdMask b) { return a.value && b.value; }
+inline SimdMask operator|(SimdMask a, SimdMask b) { return a.value || b.value; }
+inline SimdReal select(SimdMask mask, SimdReal a, SimdReal b) { return mask.value ? a : b; }
+#endif
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef TRAVERSAL_COUNTERS_H
+#define TRAVERSAL_COUNTERS_H
+
+// Work done by intersection queries. The counts are kept per thread, so the hot paths
+// only add to memory no other thread writes, and render threads collect them once they
+// are done.
+class TraversalCounters {
+  public:
+    long nodesVisited = 0;
+    // Packet tests count once per lane
+    long sphereTests = 0;
+    long triangleTests = 0;
+
+    TraversalCounters &operator+=(const TraversalCounters &other) {
+        nodesVisited += other.nodesVisited;
+        sphereTests += other.sphereTests;
+        triangleTests += other.triangleTests;
+        return *this;
+    }
+};
+
+// Counters of the calling thread
+inline TraversalCounters &traversalCounters() {
+    static thread_local TraversalCounters counters;
+    return counters;
+}
+
+#endif
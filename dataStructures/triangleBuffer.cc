@@ -0,0 +1,25 @@
+#include "triangleBuffer.h"
+#include <Eigen/Dense>
+#include <cstddef>
+
+using namespace Eigen;
+
+void TriangleBuffer::reserve(size_t count) {
+    for(auto *component: {&v0x, &v0y, &v0z, &e1x, &e1y, &e1z, &e2x, &e2y, &e2z}) {
+        component->reserve(count);
+    }
+}
+
+void TriangleBuffer::push_back(const Vector3r &v0, const Vector3r &v1, const Vector3r &v2) {
+    Vector3r edge1 = v1 - v0;
+    Vector3r edge2 = v2 - v0;
+    v0x.push_back(v0(0));
+    v0y.push_back(v0(1));
+    v0z.push_back(v0(2));
+    e1x.push_back(edge1(0));
+    e1y.push_back(edge1(1));
+    e1z.push_back(edge1(2));
+    e2x.push_back(edge2(0));
+    e2y.push_back(edge2(1));
+    e2z.push_back(edge2(2));
+}
@@ -0,0 +1,74 @@
+#ifndef TRIANGLE_BUFFER_H
+#define TRIANGLE_BUFFER_H
+
+#include "simd.h"
+#include "buffer.h"
+#include <Eigen/Dense>
+#include "precision.h"
+#include <vector>
+#include <cstddef>
+
+// Triangles stored as their first vertex and the two edges leaving it, one array per
+// component, so the intersection test reads a few contiguous doubles per triangle and
+// never has to gather vertices by index.
+class TriangleBuffer {
+  public:
+    Buffer<Real> v0x, v0y, v0z;
+    Buffer<Real> e1x, e1y, e1z;
+    Buffer<Real> e2x, e2y, e2z;
+
+    size_t size() const { return v0x.size(); }
+    void reserve(size_t count);
+    void push_back(const Vector3r &v0, const Vector3r &v1, const Vector3r &v2);
+
+    // Moller-Trumbore test. On a hit, beta and gamma are the weights of the second and
+    // third vertices. Hits on an edge or behind the origin are rejected.
+    bool intersect(size_t index, const Vector3r &origin, const Vector3r &dir,
+                   Real &distance, Real &beta, Real &gamma) const {
+        Real edge1[3] = {e1x[index], e1y[index], e1z[index]};
+        Real edge2[3] = {e2x[index], e2y[index], e2z[index]};
+        Real pvec[3] = {dir(1)*edge2[2] - dir(2)*edge2[1],
+                          dir(2)*edge2[0] - dir(0)*edge2[2],
+                          dir(0)*edge2[1] - dir(1)*edge2[0]};
+        Real det = edge1[0]*pvec[0] + edge1[1]*pvec[1] + edge1[2]*pvec[2];
+        if(det == 0) return false;
+        Real invDet = 1.0 / det;
+        Real tvec[3] = {origin(0) - v0x[index], origin(1) - v0y[index], origin(2) - v0z[index]};
+        beta = (tvec[0]*pvec[0] + tvec[1]*pvec[1] + tvec[2]*pvec[2]) * invDet;
+        if(!(beta > 0 && beta < 1)) return false;
+        Real qvec[3] = {tvec[1]*edge1[2] - tvec[2]*edge1[1],
+                          tvec[2]*edge1[0] - tvec[0]*edge1[2],
+                          tvec[0]*edge1[1] - tvec[1]*edge1[0]};
+        gamma = (dir(0)*qvec[0] + dir(1)*qvec[1] + dir(2)*qvec[2]) * invDet;
+        if(!(gamma > 0 && beta + gamma < 1)) return false;
+        distance = (edge2[0]*qvec[0] + edge2[1]*qvec[1] + edge2[2]*qvec[2]) * invDet;
+        return distance > 0;
+    }
+
+    // Same test against every ray of a packet at once. Returns one bit per lane that hit.
+    int intersectPacket(size_t index, const SimdReal origin[3], const SimdReal dir[3],
+                        SimdReal &distance, SimdReal &beta, SimdReal &gamma) const {
+        SimdReal edge1[3] = {e1x[index], e1y[index], e1z[index]};
+        SimdReal edge2[3] = {e2x[index], e2y[index], e2z[index]};
+        SimdReal pvec[3] = {dir[1]*edge2[2] - dir[2]*edge2[1],
+                              dir[2]*edge2[0] - dir[0]*edge2[2],
+                              dir[0]*edge2[1] - dir[1]*edge2[0]};
+        SimdReal det = edge1[0]*pvec[0] + edge1[1]*pvec[1] + edge1[2]*pvec[2];
+        SimdReal invDet = SimdReal(1.0) / det;
+        SimdReal tvec[3] = {origin[0] - SimdReal(v0x[index]),
+                              origin[1] - SimdReal(v0y[index]),
+                              origin[2] - SimdReal(v0z[index])};
+        beta = (tvec[0]*pvec[0] + tvec[1]*pvec[1] + tvec[2]*pvec[2]) * invDet;
+        SimdReal qvec[3] = {tvec[1]*edge1[2] - tvec[2]*edge1[1],
+                              tvec[2]*edge1[0] - tvec[0]*edge1[2],
+                              tvec[0]*edge1[1] - tvec[1]*edge1[0]};
+        gamma = (dir[0]*qvec[0] + dir[1]*qvec[1] + dir[2]*qvec[2]) * invDet;
+        distance = (edge2[0]*qvec[0] + edge2[1]*qvec[1] + edge2[2]*qvec[2]) * invDet;
+        SimdReal zero(0.0), one(1.0);
+        SimdMask hit = (det != zero) & (beta > zero) & (beta < one) & (gamma > zero)
+                     & (beta + gamma < one) & (distance > zero);
+        return hit.bits();
+    }
+};
+
+#endif
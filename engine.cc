@@ -1,7 +1,13 @@
 #include "environment/environment.h"
-#include "dataStructures/light.h"
-#include "sceneObjects/sphere.h"
-#include "dataStructures/ray.h"
+#include "renderer/framebuffer.h"
+#include "renderer/imageWriter.h"
+#include "renderer/renderOptions.h"
+#include "renderer/parallelRenderer.h"
+#include "renderer/tileCoordinator.h"
+#include "renderer/renderServer.h"
+#include "dataStructures/connection.h"
+#include "dataStructures/simd.h"
+#include "dataStructures/cacheCounters.h"
 #include <Eigen/Dense>
 #include <vector>
 #include <string>
@@ -11,126 +17,249 @@
 #include <fstream>
 #include <cmath>
 #include <chrono>
+#include <memory>
 
 using namespace std;
 using namespace Eigen;
 
-string floatToIntColorString(const Vector3d &color) {
-    int red =   max(0,min(255,static_cast<int>(round(color(0)*255))));
-    int green = max(0,min(255,static_cast<int>(round(color(1)*255))));
-    int blue =  max(0,min(255,static_cast<int>(round(color(2)*255))));
-    return to_string(red) + ' ' + to_string(green) + ' ' + to_string(blue);
+// Memory is reported per triangle of the unique meshes, which instances share
+void printMeshMemory(const MeshMemory &memory) {
+    if(memory.faces == 0) return;
+    auto perTriangle = [&](size_t bytes) {
+        return to_string((int)round(double(bytes) / memory.faces));
+    };
+    cout << "Mesh memory: " << memory.total() / (1024*1024) << " MB, "
+         << perTriangle(memory.total()) << " bytes per triangle (triangles "
+         << perTriangle(memory.triangles) << ", normals " << perTriangle(memory.normals)
+         << ", materials " << perTriangle(memory.materials) << ", BVH " << perTriangle(memory.bvh) << ")\n";
+    if(memory.build) {
+        cout << "Mesh build memory: " << memory.build / (1024*1024) << " MB, "
+             << perTriangle(memory.build) << " bytes per triangle at most\n";
+    }
 }
 
-void intersectPixel(Ray &ray, const Environment &env) {
-    for(auto &so: env.sceneObjects) {
-         so->intersectRay(ray);
+// Seconds spent in each phase of a run. Parsing covers everything in loading the scene
+// besides calculating normals and building BVHs.
+class PhaseTimes {
+  public:
+    double parse = 0;
+    double normals = 0;
+    double build = 0;
+    double render = 0;
+    double write = 0;
+};
+
+void printStatsText(const RenderCounters &counters, const PhaseTimes &phases, const CacheCounters &cache) {
+    const TraversalCounters &traversal = counters.traversal;
+    cout << fixed << setprecision(3) << "Rays: " << counters.primaryRays << " primary, " << counters.reflectionRays << " reflection, "
+         << counters.refractionRays << " refraction, " << counters.shadowRays << " shadow\n"
+         << "Shadow rays: " << counters.blockedShadowRays << " blocked, "
+         << counters.culledShadowRays << " culled (light behind the surface)\n"
+         << "Occluder cache: " << counters.occluderCacheHits << " hits in " << counters.occluderCacheLookups << " lookups";
+    if(counters.occluderCacheLookups > 0) {
+        cout << " (" << setprecision(2) << 100.0*counters.occluderCacheHits/counters.occluderCacheLookups
+             << setprecision(3) << "% hit rate)";
+    }
+    cout << "\n"
+         << "Intersection tests: " << traversal.sphereTests << " sphere, " << traversal.triangleTests << " triangle\n"
+         << "BVH nodes visited: " << traversal.nodesVisited << "\n"
+         << "Rays at each depth:";
+    for(int depth = 0; depth < RENDER_DEPTH_BUCKETS; depth++) {
+        if(counters.raysAtDepth[depth] == 0) continue;
+        cout << " " << depth << (depth == RENDER_DEPTH_BUCKETS - 1 ? "+" : "") << ": " << counters.raysAtDepth[depth];
     }
+    cout << "\n";
+    if(cache.available()) {
+        cout << "Cache misses while rendering: " << cache.misses() << " of " << cache.references() << " references\n";
+    } else {
+        cout << "Cache misses while rendering: not available on this machine\n";
+    }
+    cout << "Phases: parse " << phases.parse << " s, normals " << phases.normals << " s, build " << phases.build
+         << " s, render " << phases.render << " s, write " << phases.write << " s\n";
 }
 
-Vector3d getShadowCoeff(Ray &ray, Environment &env) {
-    Vector3d shadowCoeff = Vector3d(1.0, 1.0, 1.0);
-    for(auto obj: env.sceneObjects) {
-        obj->intersectRayWithEarlyTermination(ray);
-        if(ray.intersectObject) {
-            if(!env.transparentShadows || ray.material.transparency == Vector3d(0,0,0)) {
-                return Vector3d(0,0,0);
-            } else {
-                 shadowCoeff = shadowCoeff.cwiseProduct(ray.material.transparency);
-            }
-        }
+void printStatsJson(const RenderCounters &counters, const PhaseTimes &phases, const CacheCounters &cache,
+                    long antialiasedPixels) {
+    const TraversalCounters &traversal = counters.traversal;
+    cout << defaultfloat << setprecision(6) << "{\n"
+         << "  \"rays\": {\"primary\": " << counters.primaryRays << ", \"reflection\": " << counters.reflectionRays
+         << ", \"refraction\": " << counters.refractionRays << ", \"shadow\": " << counters.shadowRays << "},\n"
+         << "  \"shadowRays\": {\"blocked\": " << counters.blockedShadowRays << ", \"culled\": " << counters.culledShadowRays
+         << ", \"occluderCacheLookups\": " << counters.occluderCacheLookups
+         << ", \"occluderCacheHits\": " << counters.occluderCacheHits << "},\n"
+         << "  \"intersectionTests\": {\"sphere\": " << traversal.sphereTests << ", \"triangle\": " << traversal.triangleTests << "},\n"
+         << "  \"bvhNodesVisited\": " << traversal.nodesVisited << ",\n"
+         << "  \"antialiasedPixels\": " << antialiasedPixels << ",\n"
+         << "  \"raysAtDepth\": [";
+    // Trailing depths no ray reached are left out
+    int depths = RENDER_DEPTH_BUCKETS;
+    while(depths > 1 && counters.raysAtDepth[depths - 1] == 0) depths--;
+    for(int depth = 0; depth < depths; depth++) {
+        cout << (depth ? ", " : "") << counters.raysAtDepth[depth];
+    }
+    cout << "],\n";
+    if(cache.available()) {
+        cout << "  \"cache\": {\"references\": " << cache.references() << ", \"misses\": " << cache.misses() << "},\n";
+    } else {
+        cout << "  \"cache\": null,\n";
     }
-    return shadowCoeff;
+    cout << "  \"phaseSeconds\": {\"parse\": " << phases.parse << ", \"normals\": " << phases.normals
+         << ", \"build\": " << phases.build << ", \"render\": " << phases.render << ", \"write\": " << phases.write << "}\n"
+         << "}\n";
 }
 
-Vector3d pixelToColorVector(Ray &ray, Environment &env, int recursionLevel) {
-    intersectPixel(ray, env);
-    if(!ray.foundIntersect) {
-        return Vector3d(0,0,0);
-    }
-    Material &mat = ray.material;
-    Vector3d color = env.amb.cwiseProduct(mat.ambient);
-    for(const Light &light: env.lightSources) {
-        Vector3d dirToLight = light.pos - ray.intersect;
-        dirToLight = dirToLight / dirToLight.norm();
-        double intersectCosine = dirToLight.dot(ray.surfaceNormal);
-        if(intersectCosine > 0) {
-            Ray toLight;
-            toLight.origin = ray.intersect+dirToLight*0.00000001;
-            toLight.dir = dirToLight;
-            toLight.foundIntersect = true;
-            toLight.distanceToIntersect = (light.pos - toLight.origin).norm();
-            toLight.intersectObject = nullptr;
-            Vector3d shadowCoeff = getShadowCoeff(toLight, env);
-            if(shadowCoeff != Vector3d(0,0,0)) {
-                color += (mat.diffuse.cwiseProduct(light.color) * intersectCosine).cwiseProduct(shadowCoeff);
-                Vector3d interToRay = (ray.origin - ray.intersect);
-                interToRay = interToRay / interToRay.norm();
-                Vector3d reflectionRay = 2*intersectCosine*ray.surfaceNormal - dirToLight;
-                reflectionRay = reflectionRay / reflectionRay.norm();
-                double reflectCosine = reflectionRay.dot(interToRay);
-                if(reflectCosine > 0) {
-                    color += (mat.specular.cwiseProduct(light.color)*pow(reflectCosine, mat.specularExponent)).cwiseProduct(shadowCoeff);
-                }
-            }
-        }
+// Animation frames are written with their number before the extension, as image.0007.png
+string frameFileName(const string &outputFile, int frame, int frameCount) {
+    size_t dot = outputFile.rfind('.');
+    size_t slash = outputFile.rfind('/');
+    if(dot == string::npos || (slash != string::npos && dot < slash)) {
+        dot = outputFile.size();
     }
-    if(recursionLevel > 0 && mat.illuminationModel >= 3) {
-        Vector3d reflectionDir = -ray.dir;
-        if(reflectionDir.dot(ray.surfaceNormal) >= 0.1 || dynamic_cast<Sphere *>(ray.intersectObject)) {
-            reflectionDir = 2*reflectionDir.dot(ray.surfaceNormal)*ray.surfaceNormal - reflectionDir;
-            reflectionDir = reflectionDir / reflectionDir.norm();
-            Ray reflect;
-            reflect.dir = reflectionDir;
-            reflect.origin = ray.intersect;
-            color += mat.reflective.cwiseProduct(pixelToColorVector(reflect, env, recursionLevel-1));
-        }
+    string number = to_string(frame);
+    size_t digits = max<size_t>(4, to_string(frameCount - 1).size());
+    return outputFile.substr(0, dot) + "." + string(digits - number.size(), '0') + number + outputFile.substr(dot);
+}
+
+// Renders tiles for a coordinator until it has none left
+int runWorker(const char *program, const RenderOptions &options, const Environment &env, PhaseTimes &phases) {
+    string coordinator = options.workerHost + ":" + to_string(options.workerPort);
+    cout << "Rendering tiles of " << options.driverFile << " (" << env.xRes << " by " << env.yRes << ") for "
+         << coordinator << " with " << options.threadCount() << " threads\n";
+    cout.flush();
+    ParallelRenderer renderer(env, options);
+    auto renderStart = chrono::steady_clock::now();
+    long tiles;
+    try {
+        // Two tiles per thread leave the threads something to steal at the end of a batch
+        tiles = renderForCoordinator(options.workerHost, options.workerPort, env, renderer, 2*options.threadCount());
+    } catch(string s) {
+        cerr << program << " Error: " << s << '\n';
+        return 1;
     }
-    if(recursionLevel > 0 && mat.illuminationModel >= 6 && ray.material.refractiveIndex > 0.0001 && ray.intersectObject) {
-        try {
-            Ray refractRay = ray.intersectObject->getRefractionRay(ray);
-            color += mat.transparency.cwiseProduct(pixelToColorVector(refractRay, env, recursionLevel-1));
-        } catch (string s) {}
+    phases.render = chrono::duration<double>(chrono::steady_clock::now() - renderStart).count();
+    cout << "Rendered " << tiles << " tiles in " << phases.render << " seconds\n";
+    if(options.statsJson) {
+        CacheCounters cache;
+        printStatsJson(renderer.counters, phases, cache, 0);
+    } else if(options.printStats) {
+        CacheCounters cache;
+        printStatsText(renderer.counters, phases, cache);
     }
-    return color;
+    return 0;
 }
 
-string pixelToColor(double x, double y, Environment &env) {
-    double distX = ((x/(env.xRes-1.0))*(env.maxHor - env.minHor)) + env.minHor;
-    double distY = ((y/(env.yRes-1.0))*(env.minVer - env.maxVer)) + env.maxVer;
-    Ray ray;
-    ray.origin = env.eye + (-env.focalLength)*env.wCam + distX*env.uCam + distY*env.vCam;
-    ray.dir = ray.origin - env.eye;
-    ray.dir = ray.dir / ray.dir.norm();
-    Vector3d color = pixelToColorVector(ray, env, env.recursionLevel);
-    return floatToIntColorString(color);
+// Renders jobs against the loaded scene until a client sends quit, or standard input ends
+int runServer(const char *program, const RenderOptions &options, Environment &env, double loadSeconds) {
+    RenderServer server(env, options);
+    if(options.serveSocket == "-") {
+        // Standard output only carries replies
+        cerr << "Serving " << options.driverFile << " on standard input, loaded in " << loadSeconds << " seconds\n";
+        server.serve([](string &line) {
+            return bool(getline(cin, line));
+        }, [](const string &reply) {
+            cout << reply;
+            cout.flush();
+            return bool(cout);
+        });
+        cerr << "Rendered " << server.jobsDone << " jobs\n";
+        return 0;
+    }
+
+    unique_ptr<Listener> listener;
+    try {
+        listener.reset(new Listener(options.serveSocket));
+    } catch(string s) {
+        cerr << program << " Error: " << s << '\n';
+        return 1;
+    }
+    cout << "Serving " << options.driverFile << " on " << options.serveSocket << ", loaded in " << loadSeconds << " seconds\n";
+    cout.flush();
+    // One client at a time, each sending as many jobs as it likes
+    bool quit = false;
+    while(!quit) {
+        Connection client = listener->accept(-1);
+        if(!client.isOpen()) continue;
+        quit = server.serve([&](string &line) {
+            return client.readLine(line);
+        }, [&](const string &reply) {
+            return client.write(reply.data(), reply.size());
+        });
+    }
+    cout << "Rendered " << server.jobsDone << " jobs\n";
+    return 0;
 }
 
 int main(int argc, char **argv) {
-    if(argc < 3) {
-        cerr << "Usage: " << argv[0] << " driverInput ppmOutput\n";
+    RenderOptions options;
+    try {
+        options = RenderOptions(argc, argv);
+    } catch(string s) {
+        cerr << argv[0] << " Error: " << s << '\n';
+        cerr << renderUsage(argv[0]);
         return 1;
     }
 
-    string driverFile(argv[1]);
-    string outputFile(argv[2]);
+    string driverFile(options.driverFile);
+    string outputFile(options.outputFile);
     Environment env;
 
     auto startTime = chrono::steady_clock::now();
 
     try {
-        env = Environment(driverFile);
+        MeshOptions meshOptions;
+        meshOptions.cacheDirectory = options.meshCacheDirectory;
+        meshOptions.octNormals = options.octNormals;
+        env = Environment(driverFile, meshOptions);
     } catch(string s) {
         cerr << argv[0] << " Error: Failed to parse input file " << driverFile << '\n';
         cerr << s << '\n';
         return 1;
     }
+    PhaseTimes phases;
+    phases.normals = env.normalsSeconds;
+    phases.build = env.bvhBuildSeconds;
+    phases.parse = max(0.0, chrono::duration<double>(chrono::steady_clock::now() - startTime).count()
+                            - phases.normals - phases.build);
+    if(!options.workerHost.empty()) {
+        return runWorker(argv[0], options, env, phases);
+    }
+    if(!options.serveSocket.empty()) {
+        return runServer(argv[0], options, env, chrono::duration<double>(chrono::steady_clock::now() - startTime).count());
+    }
 
-    ofstream output(outputFile, ofstream::trunc);
+    unique_ptr<ImageWriter> writer;
+    try {
+        writer = imageWriterFor(outputFile, options.format);
+    } catch(string s) {
+        cerr << argv[0] << " Error: " << s << '\n';
+        return 1;
+    }
+
+    bool animated = env.frameCount > 1;
+    if(animated && (options.progressive || options.coordinatorPort > 0)) {
+        cerr << argv[0] << " Error: Animations can't be rendered progressively or distributed\n";
+        return 1;
+    }
+    // Each frame of an animation goes to a file of its own
+    string firstFile = animated ? frameFileName(outputFile, 0, env.frameCount) : outputFile;
+    ofstream output(firstFile, ofstream::trunc | ofstream::binary);
     if(!output) {
-        cerr << argv[0] << " Error: Failed to open output file " << outputFile << '\n';
+        cerr << argv[0] << " Error: Failed to open output file " << firstFile << '\n';
         return 1;
     }
+    if(options.progressive || animated) {
+        output.close();
+    }
+    // Listening before the banner lets workers connect while it is printed
+    unique_ptr<TileCoordinator> coordinator;
+    if(options.coordinatorPort > 0) {
+        try {
+            coordinator.reset(new TileCoordinator(options.coordinatorPort, env.xRes, env.yRes, options.tileSize));
+        } catch(string s) {
+            cerr << argv[0] << " Error: " << s << '\n';
+            return 1;
+        }
+    }
 
     auto curTime = chrono::steady_clock::now();
     auto elapsed = chrono::duration_cast<chrono::milliseconds>(curTime - startTime);
@@ -139,46 +268,186 @@ int main(int argc, char **argv) {
          << "Scene resolution: " << env.xRes << " by " << env.yRes << "\n"
          << "Number of objects: " << env.sceneObjects.size() << "\n"
          << "Number of faces: " << env.numFaces << "\n"
+         << "Unique meshes: " << env.meshes.size();
+    if(!options.meshCacheDirectory.empty()) {
+        cout << " (" << env.meshesFromCache << " loaded from cache)";
+    }
+    cout << "\n"
+         << "BVH nodes: " << env.numBVHNodes << " (built in " << env.bvhBuildSeconds << " seconds)\n"
+         << "Scene load time: " << secElapsed/1000.0 << " seconds\n"
          << "Number of lights: " << env.lightSources.size() << "\n"
-         << "Recursion level: " << env.recursionLevel << "\n\n"
+         << "Recursion level: " << env.recursionLevel << "\n"
+         << "Precision: " PRECISION_NAME "\n";
+    if(options.printStats) {
+        printMeshMemory(env.meshMemory());
+    }
+    cout << "Output format: " << writer->formatName() << "\n"
+         << "Render threads: " << options.threadCount() << "\n"
+         << "Anti-aliasing: ";
+    if(options.aaSamples > 1) {
+        cout << options.aaSamples << " rays in pixels differing by more than " << options.aaThreshold << "\n";
+    } else {
+        cout << "off\n";
+    }
+    cout << "Progressive: ";
+    if(!options.progressive) {
+        cout << "off\n";
+    } else if(options.timeBudget > 0) {
+        cout << "stopping " << options.timeBudget << " seconds after start up\n";
+    } else {
+        cout << "on\n";
+    }
+    if(coordinator) {
+        cout << "Rendered by: workers connecting to port " << coordinator->port() << "\n";
+    }
+    if(animated) {
+        cout << "Frames: " << env.frameCount << ", " << (options.rebuildBVH ? "rebuilding" : "refitting")
+             << " the scene BVH between them\n";
+    }
+    cout << "Primary ray packets: " << (options.progressive ? string("off") : options.usePackets ? to_string(SIMD_WIDTH) + " rays (" SIMD_INSTRUCTION_SET ")" : string("off")) << "\n\n"
          << "Progress: 0.00%  Time Elapsed: " << secElapsed/1000.0 << " seconds";
     cout.flush();
 
-    output << "P3\n";
-    output << env.xRes << ' ' << env.yRes << " 255\n";
-
-    int count = 0;
-    int interval = max(2, static_cast<int>(env.xRes/100));
-
-    for(int x = 0; x < env.xRes; x++) {
-        string pixels[env.yRes];
-        for(int y = 0;  y < env.yRes; y++)
-            pixels[y] =  pixelToColor(y, x, env);
-        for(int y = 0; y < env.yRes; y++)
-            output << pixels[y] << ' ';
-        output << '\n';
-        if(++count == interval) {
-            count = 0;
-            curTime = chrono::steady_clock::now();
-            elapsed = chrono::duration_cast<chrono::milliseconds>(curTime - startTime);
-            secElapsed = elapsed.count();
-            double fractionComplete = (x*1.0)/(env.xRes*1.0);
+    Framebuffer image;
+    ParallelRenderer renderer(env, options);
+    if(options.timeBudget > 0) {
+        renderer.deadline = startTime + chrono::duration_cast<chrono::steady_clock::duration>(
+            chrono::duration<double>(options.timeBudget));
+    }
+    bool saveFailed = false;
+    string failedFile = outputFile;
+    renderer.passDone = [&](const Framebuffer &partialImage) {
+        auto writeStart = chrono::steady_clock::now();
+        saveFailed = !saveImage(*writer, partialImage, outputFile);
+        phases.write += chrono::duration<double>(chrono::steady_clock::now() - writeStart).count();
+    };
+    // Summed over the frames of an animation
+    RenderCounters counters;
+    long antialiasedPixels = 0;
+    int frame = 0;
+    double frameSeconds = 0;
+    // Spent refitting or rebuilding the scene BVH between frames
+    double updateSeconds = 0;
+    // Only opened for statistics, since it is a system call per thread
+    unique_ptr<CacheCounters> cacheCounters(options.printStats ? new CacheCounters : nullptr);
+    if(cacheCounters) {
+        cacheCounters->start();
+    }
+    auto renderStart = chrono::steady_clock::now();
+    auto progress = [&](double fractionComplete) {
+        curTime = chrono::steady_clock::now();
+        elapsed = chrono::duration_cast<chrono::milliseconds>(curTime - startTime);
+        secElapsed = elapsed.count();
+        cout << "\r" << string(100, ' ');
+        cout << "\rProgress: " << fixed << setprecision(2) << fractionComplete*100.0 << "%  Time Elapsed: "
+           << secElapsed/1000.0  << " seconds";
+        // Nothing to estimate from until some of the image is done
+        if(fractionComplete > 0) {
             double timeRemaining = 1.0/fractionComplete*secElapsed - secElapsed;
-            cout << "\r" << string(100, ' ');
-            cout << "\rProgress: " << fixed << setprecision(2) << fractionComplete*100.0 << "%  Time Elapsed: "
-               << secElapsed/1000.0  << " seconds. Estimated time remaining: " << timeRemaining/1000.0 << " seconds";
-            cout.flush();
+            cout << ". Estimated time remaining: " << timeRemaining/1000.0 << " seconds";
         }
+        if(options.progressive) {
+            cout << ". Pass " << min(renderer.passesDone + 1, renderer.totalPasses) << " of " << renderer.totalPasses;
+        }
+        if(animated) {
+            cout << ". Frame " << frame + 1 << " of " << env.frameCount;
+        }
+        cout.flush();
+    };
+    if(coordinator) {
+        coordinator->render(image, progress);
+    } else if(animated) {
+        // Loading placed everything for the first frame
+        double loadBuildSeconds = env.bvhBuildSeconds;
+        for(frame = 0; frame < env.frameCount; frame++) {
+            if(frame > 0) {
+                env.setFrame(frame, options.rebuildBVH);
+            }
+            renderer.render(image, [&](double fractionComplete) {
+                progress((frame + fractionComplete) / env.frameCount);
+            });
+            counters += renderer.counters;
+            antialiasedPixels += renderer.antialiasedPixels;
+            auto writeStart = chrono::steady_clock::now();
+            string frameFile = frameFileName(outputFile, frame, env.frameCount);
+            if(!saveFailed && !saveImage(*writer, image, frameFile)) {
+                saveFailed = true;
+                failedFile = frameFile;
+            }
+            phases.write += chrono::duration<double>(chrono::steady_clock::now() - writeStart).count();
+        }
+        frame = env.frameCount - 1;
+        updateSeconds = env.bvhBuildSeconds - loadBuildSeconds;
+        phases.build += updateSeconds;
+        frameSeconds = chrono::duration<double>(chrono::steady_clock::now() - renderStart).count();
+    } else {
+        renderer.render(image, progress);
     }
+    if(!animated) {
+        counters = renderer.counters;
+        antialiasedPixels = renderer.antialiasedPixels;
+    }
+    if(cacheCounters) {
+        cacheCounters->stop();
+    }
+    // Progressive renders and animations write images between renders, and animations
+    // update the scene BVH
+    phases.render = chrono::duration<double>(chrono::steady_clock::now() - renderStart).count() - phases.write
+                    - updateSeconds;
 
+    auto writeStart = chrono::steady_clock::now();
+    if(options.progressive || animated) {
+        // The last pass or frame has already been written
+        if(saveFailed) {
+            cerr << "\n" << argv[0] << " Error: Failed to write output file " << failedFile << '\n';
+            return 1;
+        }
+    } else {
+        writer->write(image, output);
+        output.close();
+        phases.write = chrono::duration<double>(chrono::steady_clock::now() - writeStart).count();
+        if(!output) {
+            cerr << "\n" << argv[0] << " Error: Failed to write output file " << outputFile << '\n';
+            return 1;
+        }
+    }
 
     curTime = chrono::steady_clock::now();
     elapsed = chrono::duration_cast<chrono::milliseconds>(curTime - startTime);
     secElapsed = elapsed.count();
-    cout << "\r" << string(100, ' ')
-         << "\rProgress: 100.00%\n"
-         << "Total Time Elapsed: " << secElapsed/1000.0 << " seconds\n"
-         << "Raytracing complete! Output image should be saved in " << outputFile << ".\n";
+    cout << "\r" << string(100, ' ');
+    if(renderer.stoppedAtDeadline) {
+        cout << "\rStopped at the time budget after " << renderer.passesDone << " of " << renderer.totalPasses << " passes\n";
+    } else {
+        cout << "\rProgress: 100.00%\n";
+    }
+    cout << "Total Time Elapsed: " << secElapsed/1000.0 << " seconds\n";
+    if(animated) {
+        cout << "Frames: " << env.frameCount << " in " << frameSeconds << " seconds, " << env.frameCount / frameSeconds
+             << " frames per second (" << (options.rebuildBVH ? "rebuilding" : "refitting") << " the scene BVH took "
+             << updateSeconds << " seconds)\n";
+    }
+    if(coordinator) {
+        cout << "Workers: " << coordinator->workersConnected << ", tiles handed out again after their worker left: "
+             << coordinator->tilesRedispatched << "\n";
+    }
+    if(options.printStats && !options.statsJson) {
+        if(options.aaSamples > 1) {
+            cout << "Anti-aliased pixels: " << antialiasedPixels << " ("
+                 << 100.0*antialiasedPixels/(env.xRes*env.yRes*env.frameCount) << "%)\n";
+        }
+        printStatsText(counters, phases, *cacheCounters);
+    }
+    if(animated) {
+        cout << "Raytracing complete! Output images should be saved in " << firstFile << " to "
+             << frameFileName(outputFile, env.frameCount - 1, env.frameCount) << ".\n";
+    } else {
+        cout << "Raytracing complete! Output image should be saved in " << outputFile << ".\n";
+    }
+    // Last, so that everything from the first line starting with { is the JSON
+    if(options.statsJson) {
+        printStatsJson(counters, phases, *cacheCounters, antialiasedPixels);
+    }
 
     return 0;
 }
@@ -0,0 +1,57 @@
+#include "animation.h"
+#include "../sceneObjects/sphere.h"
+#include "../sceneObjects/model.h"
+#include "../sceneObjects/transformation.h"
+#include <Eigen/Dense>
+#include <vector>
+#include <memory>
+
+using namespace std;
+using namespace Eigen;
+
+// Finds the keys frame lies between, returning how far it is from the first to the second
+template<typename Key>
+double keysAround(const vector<Key> &keys, int frame, const Key *&before, const Key *&after) {
+    before = &keys.front();
+    after = &keys.front();
+    for(const Key &key: keys) {
+        after = &key;
+        if(key.frame > frame) break;
+        before = &key;
+    }
+    if(after->frame <= before->frame) return 0;
+    return double(frame - before->frame) / (after->frame - before->frame);
+}
+
+CameraKey cameraAtFrame(const vector<CameraKey> &keys, int frame) {
+    const CameraKey *before, *after;
+    Real t = keysAround(keys, frame, before, after);
+    CameraKey camera;
+    camera.frame = frame;
+    camera.eye = before->eye + t*(after->eye - before->eye);
+    camera.look = before->look + t*(after->look - before->look);
+    camera.up = before->up + t*(after->up - before->up);
+    return camera;
+}
+
+Matrix4r motionAtFrame(const vector<ObjectKey> &keys, int frame) {
+    const ObjectKey *before, *after;
+    double t = keysAround(keys, frame, before, after);
+    auto mix = [&](double from, double to) { return from + t*(to - from); };
+    Transformation motion(mix(before->wx, after->wx), mix(before->wy, after->wy), mix(before->wz, after->wz),
+                          mix(before->theta, after->theta), mix(before->scale, after->scale),
+                          mix(before->tx, after->tx), mix(before->ty, after->ty), mix(before->tz, after->tz));
+    return motion.getTransformationMatrix();
+}
+
+void ObjectAnimation::place(int frame) const {
+    Matrix4r motion = motionAtFrame(keys, frame);
+    if(model) {
+        model->place(motion);
+        return;
+    }
+    // Spheres stay spheres, so only the scale, not the rotation, changes their shape
+    Vector4d moved = motion.cast<double>() * Vector4d(center(0), center(1), center(2), 1);
+    sphere->center = moved.head<3>();
+    sphere->radius = radius * motion.topLeftCorner<3,3>().col(0).cast<double>().norm();
+}
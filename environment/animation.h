@@ -0,0 +1,49 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include "../sceneObjects/sphere.h"
+#include "../sceneObjects/model.h"
+#include "../dataStructures/precision.h"
+#include <Eigen/Dense>
+#include <vector>
+#include <memory>
+
+// Camera at a keyframe
+class CameraKey {
+  public:
+    int frame;
+    Vector3r eye;
+    Vector3r look;
+    Vector3r up;
+};
+
+// Motion of an object at a keyframe, on top of where the driver file placed it: a
+// rotation of theta degrees about the axis, then uniform scaling, then translation
+class ObjectKey {
+  public:
+    int frame;
+    double wx, wy, wz;
+    double theta;
+    double scale;
+    double tx, ty, tz;
+};
+
+// Keys are kept sorted by frame. Between two keys every value is interpolated linearly,
+// before the first and after the last key the nearest one holds.
+CameraKey cameraAtFrame(const std::vector<CameraKey> &keys, int frame);
+Matrix4r motionAtFrame(const std::vector<ObjectKey> &keys, int frame);
+
+// Keys moving one sphere or model, whichever is set
+class ObjectAnimation {
+  public:
+    std::shared_ptr<Sphere> sphere;
+    // Where the driver file placed the sphere
+    Eigen::Vector3d center;
+    double radius = 0;
+    std::shared_ptr<Model> model;
+    std::vector<ObjectKey> keys;
+
+    void place(int frame) const;
+};
+
+#endif
@@ -2,6 +2,8 @@
 #include "environment.h"
 #include "../sceneObjects/sphere.h"
 #include "../sceneObjects/model.h"
+#include "../sceneObjects/mesh.h"
+#include "../sceneObjects/transformation.h"
 #include "../dataStructures/material.h"
 #include "../dataStructures/light.h"
 #include <boost/tokenizer.hpp>
@@ -11,12 +13,15 @@
 #include <vector>
 #include <cstdlib>
 #include <algorithm>
+#include <memory>
+#include <chrono>
 
 using namespace std;
 using namespace boost;
 using namespace Eigen;
 
-Environment::Environment(const string &driverFile) {
+Environment::Environment(const string &driverFile, const MeshOptions &meshOptions)
+  : meshOptions(meshOptions) {
     ifstream file(driverFile);
     if(!file) {
         throw string("Couldn't open driver files");
@@ -26,7 +31,10 @@ Environment::Environment(const string &driverFile) {
         if(!line.empty())
           processLine(line);
     }
+    placeForFrame(0);
     setupCamera();
+    buildSceneBVH();
+    lightTree.build(lightSources);
 }
 
 void Environment::processLine(const string &line) {
@@ -41,10 +49,55 @@ void Environment::processLine(const string &line) {
     }
 }
 
+void Environment::processViewLine(const string &line) {
+    char_separator<char> sep(" \n\t\r");
+    tokenizer<char_separator<char>> tokens((line), sep);
+    if(tokens.begin() == tokens.end()) return;
+    const string type = *tokens.begin();
+    if(type != "eye" && type != "look" && type != "up" && type != "d" && type != "bounds"
+       && type != "res" && type != "recursionlevel") {
+        throw string("Only eye, look, up, d, bounds, res and recursionlevel lines can change the view\n");
+    }
+    processLine(line);
+    setupCamera();
+}
+
+void Environment::processAddLine(const string &line) {
+    char_separator<char> sep(" \n\t\r");
+    tokenizer<char_separator<char>> tokens((line), sep);
+    if(tokens.begin() == tokens.end()) return;
+    const string type = *tokens.begin();
+    if(type != "sphere" && type != "model" && type != "light") {
+        throw string("Only sphere, model and light lines can add to the scene\n");
+    }
+    processLine(line);
+}
+
 void Environment::processTransparentShadows() {
     transparentShadows = getOneVal() == 1.0;   
 }
 
+void Environment::processLightSampling() {
+    if(++lineIt == lineEnd) {
+        throw string("Ran out of input while parsing line\n");
+    }
+    string mode = *lineIt;
+    if(mode == "exact") {
+        lightSampling = LightSampling::Exact;
+    } else if(mode == "sampled") {
+        lightSampling = LightSampling::Sampled;
+        lightSamples = getOneVal();
+        if(lightSamples < 1) {
+            throw string("Light sampling needs at least one sample\n");
+        }
+    } else if(mode == "clustered") {
+        lightSampling = LightSampling::Clustered;
+        clusterThreshold = getOneVal();
+    } else {
+        throw string("Unknown light sampling mode " + mode + "\n");
+    }
+}
+
 void Environment::processLineByType(const string &line) {
     string type = *lineIt;
     if(type == "eye")     
@@ -71,6 +124,14 @@ void Environment::processLineByType(const string &line) {
           processRecursionLevel();
     else if(type == "transparentShadows")
           processTransparentShadows();
+    else if(type == "lightsampling")
+          processLightSampling();
+    else if(type == "frames")
+          processFrames();
+    else if(type == "camerakey")
+          processCameraKey();
+    else if(type == "objectkey")
+          processObjectKey();
     else if(type[0] == '#')    
           ; // Ignore comments, but they aren't invalid
     else
@@ -158,22 +219,111 @@ void Environment::processSphere() {
     sphere->material.reflective(1) = getOneVal();
     sphere->material.reflective(2) = getOneVal();
     sphere->material.refractiveIndex = getOneVal();
-    sphere->material.transparency = Vector3d(1,1,1) - sphere->material.reflective;
+    sphere->material.transparency = Vector3r(1,1,1) - sphere->material.reflective;
     sphere->material.specularExponent = 16;
     sphere->material.illuminationModel = 6;
     sceneObjects.emplace_back(sphere);
 }
 
 void Environment::processModel(const string &line) {
-    Model *model = new Model(line);
-    numFaces += model->numFaces;
-    sceneObjects.emplace_back(model);
+    Transformation transformation(line);
+    std::shared_ptr<const Mesh> &mesh = meshes[make_pair(transformation.file, transformation.angleCutoff)];
+    if(!mesh) {
+        mesh = std::make_shared<Mesh>(transformation.file, transformation.angleCutoff, meshOptions);
+        meshesFromCache += mesh->loadedFromCache;
+        numBVHNodes += mesh->numBVHNodes();
+        normalsSeconds += mesh->normalsSeconds;
+        bvhBuildSeconds += mesh->bvhBuildSeconds;
+    }
+    numFaces += mesh->numFaces;
+    sceneObjects.emplace_back(new Model(mesh, transformation));
 }
 
 void Environment::processRecursionLevel() {
     recursionLevel = getOneVal();
 }
 
+void Environment::processFrames() {
+    frameCount = getOneVal();
+    if(frameCount < 1) {
+        throw string("An animation needs at least one frame\n");
+    }
+}
+
+void Environment::processCameraKey() {
+    CameraKey key;
+    key.frame = getOneVal();
+    for(Vector3r *vector: {&key.eye, &key.look, &key.up}) {
+        for(int axis = 0; axis < 3; axis++) {
+            (*vector)(axis) = getOneVal();
+        }
+    }
+    auto later = upper_bound(cameraKeys.begin(), cameraKeys.end(), key.frame,
+                             [](int frame, const CameraKey &other) { return frame < other.frame; });
+    cameraKeys.insert(later, key);
+}
+
+void Environment::processObjectKey() {
+    if(sceneObjects.empty()) {
+        throw string("An objectkey line must follow the sphere or model it moves\n");
+    }
+    ObjectKey key;
+    key.frame = getOneVal();
+    key.wx = getOneVal();
+    key.wy = getOneVal();
+    key.wz = getOneVal();
+    key.theta = getOneVal();
+    key.scale = getOneVal();
+    key.tx = getOneVal();
+    key.ty = getOneVal();
+    key.tz = getOneVal();
+    // Keys of the same object follow each other, so only the last animation can be its own
+    const std::shared_ptr<SceneObject> &object = sceneObjects.back();
+    if(objectAnimations.empty() || (objectAnimations.back().sphere != object && objectAnimations.back().model != object)) {
+        ObjectAnimation animation;
+        animation.model = std::dynamic_pointer_cast<Model>(object);
+        animation.sphere = std::dynamic_pointer_cast<Sphere>(object);
+        if(animation.sphere) {
+            animation.center = animation.sphere->center;
+            animation.radius = animation.sphere->radius;
+        }
+        objectAnimations.push_back(animation);
+    }
+    vector<ObjectKey> &keys = objectAnimations.back().keys;
+    auto later = upper_bound(keys.begin(), keys.end(), key.frame,
+                             [](int frame, const ObjectKey &other) { return frame < other.frame; });
+    keys.insert(later, key);
+}
+
+void Environment::placeForFrame(int frame) {
+    if(!cameraKeys.empty()) {
+        CameraKey camera = cameraAtFrame(cameraKeys, frame);
+        eye = camera.eye;
+        look = camera.look;
+        up = camera.up;
+    }
+    for(const ObjectAnimation &animation: objectAnimations) {
+        animation.place(frame);
+    }
+}
+
+void Environment::setFrame(int frame, bool rebuildBVH) {
+    placeForFrame(frame);
+    setupCamera();
+    if(rebuildBVH) {
+        numBVHNodes -= sceneBVH.nodes.size();
+        buildSceneBVH();
+        return;
+    }
+    auto startTime = chrono::steady_clock::now();
+    vector<BoundingBox> objectBounds;
+    for(const auto &object: sceneObjects) {
+        objectBounds.push_back(object->getBounds());
+    }
+    sceneBVH.refit(objectBounds);
+    bvhBuildSeconds += chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+}
+
 void Environment::setupCamera() {
     wCam = eye - look;
     wCam = wCam / wCam.norm();
@@ -186,6 +336,53 @@ void Environment::setupCamera() {
     }
 }
 
-double distance(const Vector3d v1, const Vector3d v2) {
+void Environment::buildSceneBVH() {
+    auto startTime = chrono::steady_clock::now();
+    vector<BoundingBox> objectBounds;
+    for(const auto &object: sceneObjects) {
+        objectBounds.push_back(object->getBounds());
+    }
+    sceneBVH.build(objectBounds);
+    numBVHNodes += sceneBVH.nodes.size();
+    bvhBuildSeconds += chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+}
+
+MeshMemory Environment::meshMemory() const {
+    MeshMemory memory;
+    for(const auto &mesh: meshes) {
+        memory += mesh.second->memory();
+    }
+    return memory;
+}
+
+void Environment::intersectRay(Ray &ray) const {
+    forEachObjectAlong(ray, [&](const SceneObject &object) {
+        object.intersectRay(ray);
+        return false;
+    });
+    if(ray.intersectObject) {
+        ray.intersectObject->resolveHit(ray);
+    }
+}
+
+void Environment::intersectPacket(RayPacket &packet) const {
+    sceneBVH.traversePacket(packet, [&](int position) {
+        sceneObjects[sceneBVH.primitiveIndices[position]]->intersectPacket(packet);
+    });
+}
+
+void Environment::resolvePacketHit(const RayPacket &packet, int lane, Ray &ray) const {
+    if(packet.hitObject[lane]) {
+        ray.foundIntersect = true;
+        ray.distanceToIntersect = packet.distance[lane];
+        ray.intersectObject = packet.hitObject[lane];
+        ray.primitiveIndex = packet.hitPrimitive[lane];
+        ray.beta = packet.beta[lane];
+        ray.gamma = packet.gamma[lane];
+        ray.intersectObject->resolveHit(ray);
+    }
+}
+
+Real distance(const Vector3r v1, const Vector3r v2) {
     return (v2-v1).norm();
 };
@@ -2,37 +2,96 @@
 #define ENVIRONMENT_H
 
 #include "../dataStructures/light.h"
+#include "../dataStructures/lightTree.h"
 #include "../sceneObjects/sceneObject.h"
+#include "../sceneObjects/mesh.h"
+#include "../dataStructures/bvh.h"
+#include "../dataStructures/ray.h"
+#include "../dataStructures/rayPacket.h"
+#include "animation.h"
 #include <boost/tokenizer.hpp>
 #include <Eigen/Dense>
 #include <vector>
 #include <string>
 #include <memory>
+#include <map>
+#include <utility>
+
+// How a shading point picks the lights it traces shadow rays to
+enum class LightSampling {
+    // Every light
+    Exact,
+    // lightSamples lights drawn from the light tree by importance
+    Sampled,
+    // A cut through the light tree, with far away clusters shading as one light
+    Clustered
+};
 
 class Environment {
   public:
-    Eigen::Vector3d eye;
-    Eigen::Vector3d look;
-    Eigen::Vector3d up;
-    Eigen::Vector3d uCam;
-    Eigen::Vector3d vCam;
-    Eigen::Vector3d wCam;
-    double focalLength;
-    double minHor, minVer, maxHor, maxVer;
+    Vector3r eye;
+    Vector3r look;
+    Vector3r up;
+    Vector3r uCam;
+    Vector3r vCam;
+    Vector3r wCam;
+    Real focalLength;
+    Real minHor, minVer, maxHor, maxVer;
     long xRes, yRes;
-    Eigen::Vector3d amb;
+    Vector3r amb;
     std::vector<Light> lightSources;
     std::vector<std::shared_ptr<SceneObject>> sceneObjects;
+    // Top level hierarchy over the bounds of every scene object
+    BVH sceneBVH;
+    // Geometry shared between models, keyed by file and exact smoothing cutoff
+    std::map<std::pair<std::string, double>, std::shared_ptr<const Mesh>> meshes;
     int recursionLevel;
     int numFaces = 0;
+    int numBVHNodes = 0;
+    int meshesFromCache = 0;
+    double normalsSeconds = 0;
+    double bvhBuildSeconds = 0;
     bool transparentShadows = false;
+    LightSampling lightSampling = LightSampling::Exact;
+    int lightSamples = 1;
+    Real clusterThreshold = 0.1;
+    LightTree lightTree;
+    // Frames of an animation, and the keys moving the camera and objects through them
+    int frameCount = 1;
+    std::vector<CameraKey> cameraKeys;
+    std::vector<ObjectAnimation> objectAnimations;
 
-    Environment(const std::string &driverFile);
+    Environment(const std::string &driverFile, const MeshOptions &meshOptions = MeshOptions());
     Environment() = default;
     Environment(const Environment &) = default;
     Environment &operator=(const Environment &) = default;
 
+    // Memory held by every unique mesh
+    MeshMemory meshMemory() const;
+    // Applies a driver file line which only changes the view: eye, look, up, d, bounds,
+    // res or recursionlevel. Throws a string for any other line, which would need the
+    // scene to be built again.
+    void processViewLine(const std::string &line);
+    // Applies a sphere, model or light line of a driver file, adding to the scene without
+    // building the scene BVH or light tree again. Throws a string for any other line.
+    void processAddLine(const std::string &line);
+    // Moves the camera and objects to where their keys put them at frame, then refits the
+    // scene BVH to the objects' new bounds, or builds it again with rebuildBVH. The
+    // objects are shared with copies of the environment, which move too.
+    void setFrame(int frame, bool rebuildBVH = false);
+
+    // Finds the closest object the ray hits
+    void intersectRay(Ray &ray) const;
+    // Finds the closest object for every ray of the packet, then fills in the hit record
+    // of one lane's ray (which must have that lane's origin and direction)
+    void intersectPacket(RayPacket &packet) const;
+    void resolvePacketHit(const RayPacket &packet, int lane, Ray &ray) const;
+    // Calls visit(object) for the objects along the ray, nearest subtree first, until it returns true
+    template<typename Visitor>
+    void forEachObjectAlong(const Ray &ray, Visitor visit) const;
+
   private:
+    MeshOptions meshOptions;
     void processLine(const std::string &);
     void processLineByType(const std::string &);
     void processEye();
@@ -47,13 +106,26 @@ class Environment {
     void processModel(const std::string &);
     void processRecursionLevel();
     void processTransparentShadows();
+    void processLightSampling();
+    void processFrames();
+    void processCameraKey();
+    void processObjectKey();
+    void placeForFrame(int frame);
     void setupCamera();
+    void buildSceneBVH();
     double getOneVal();
 
     boost::tokenizer<boost::char_separator<char>>::iterator lineIt;
     boost::tokenizer<boost::char_separator<char>>::iterator lineEnd;
 };
 
-double distance(Eigen::Vector3d, Eigen::Vector3d);
+Real distance(Vector3r, Vector3r);
+
+template<typename Visitor>
+void Environment::forEachObjectAlong(const Ray &ray, Visitor visit) const {
+    sceneBVH.traverse(ray, [&](int position) {
+        return visit(*sceneObjects[sceneBVH.primitiveIndices[position]]);
+    });
+}
 
 #endif
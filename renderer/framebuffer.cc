@@ -0,0 +1,11 @@
+#include "framebuffer.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+Framebuffer::Framebuffer(long width, long height): width(width), height(height), pixels(3*width*height, 0.0f) {}
+
+unsigned char colorComponentToByte(double component) {
+    return max(0, min(255, static_cast<int>(round(component*255))));
+}
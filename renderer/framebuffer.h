@@ -0,0 +1,38 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <Eigen/Dense>
+#include "../dataStructures/precision.h"
+#include <vector>
+
+// Linear floating point RGB image, stored row by row from the top left corner
+class Framebuffer {
+  public:
+    long width = 0;
+    long height = 0;
+
+    Framebuffer() = default;
+    Framebuffer(long width, long height);
+
+    void setPixel(long x, long y, const Vector3r &color) {
+        float *pixel = &pixels[3*(y*width + x)];
+        pixel[0] = color(0);
+        pixel[1] = color(1);
+        pixel[2] = color(2);
+    }
+
+    Eigen::Vector3d getPixel(long x, long y) const {
+        const float *pixel = &pixels[3*(y*width + x)];
+        return Eigen::Vector3d(pixel[0], pixel[1], pixel[2]);
+    }
+
+    const float *row(long y) const { return &pixels[3*y*width]; }
+
+  private:
+    std::vector<float> pixels;
+};
+
+// Maps a colour component on the 0-1 scale to 0-255, clamping anything outside it
+unsigned char colorComponentToByte(double component);
+
+#endif
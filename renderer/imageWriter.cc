@@ -0,0 +1,355 @@
+#include "imageWriter.h"
+#include "framebuffer.h"
+#include <Eigen/Dense>
+#include <ostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+
+using namespace std;
+using namespace Eigen;
+
+string floatToIntColorString(const Vector3d &color) {
+    int red =   colorComponentToByte(color(0));
+    int green = colorComponentToByte(color(1));
+    int blue =  colorComponentToByte(color(2));
+    return to_string(red) + ' ' + to_string(green) + ' ' + to_string(blue);
+}
+
+void AsciiPPMWriter::write(const Framebuffer &image, ostream &output) const {
+    output << "P3\n";
+    output << image.width << ' ' << image.height << " 255\n";
+    for(long y = 0; y < image.height; y++) {
+        for(long x = 0; x < image.width; x++)
+            output << floatToIntColorString(image.getPixel(x, y)) << ' ';
+        output << '\n';
+    }
+}
+
+vector<unsigned char> rowToBytes(const Framebuffer &image, long y) {
+    vector<unsigned char> bytes(3*image.width);
+    const float *row = image.row(y);
+    for(long i = 0; i < 3*image.width; i++) {
+        bytes[i] = colorComponentToByte(row[i]);
+    }
+    return bytes;
+}
+
+void BinaryPPMWriter::write(const Framebuffer &image, ostream &output) const {
+    output << "P6\n" << image.width << ' ' << image.height << "\n255\n";
+    for(long y = 0; y < image.height; y++) {
+        vector<unsigned char> bytes = rowToBytes(image, y);
+        output.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+    }
+}
+
+void PFMWriter::write(const Framebuffer &image, ostream &output) const {
+    // A negative scale marks the data as little endian. Rows run from the bottom up.
+    output << "PF\n" << image.width << ' ' << image.height << "\n-1.0\n";
+    for(long y = image.height - 1; y >= 0; y--) {
+        vector<unsigned char> bytes(3*image.width*4);
+        const float *row = image.row(y);
+        for(long i = 0; i < 3*image.width; i++) {
+            uint32_t bits;
+            static_assert(sizeof(float) == sizeof(uint32_t), "PFM needs 32 bit floats");
+            memcpy(&bits, &row[i], sizeof(bits));
+            for(int byte = 0; byte < 4; byte++) {
+                bytes[4*i + byte] = (bits >> (8*byte)) & 0xff;
+            }
+        }
+        output.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+    }
+}
+
+// Deflate (RFC 1951) with the fixed Huffman codes and a hash chain match finder.
+// It compresses far less than zlib's best, but rendered images are smooth enough for
+// the PNG row filters and back references to pay off well.
+
+class BitWriter {
+  public:
+    vector<unsigned char> bytes;
+
+    // Values are packed starting from the least significant bit
+    void writeBits(uint32_t value, int count) {
+        bitBuffer |= static_cast<uint64_t>(value) << bitCount;
+        bitCount += count;
+        while(bitCount >= 8) {
+            bytes.push_back(bitBuffer & 0xff);
+            bitBuffer >>= 8;
+            bitCount -= 8;
+        }
+    }
+
+    // Huffman codes are packed starting from their most significant bit
+    void writeCode(uint32_t code, int length) {
+        uint32_t reversed = 0;
+        for(int i = 0; i < length; i++) {
+            reversed = (reversed << 1) | ((code >> i) & 1);
+        }
+        writeBits(reversed, length);
+    }
+
+    void flush() {
+        if(bitCount > 0) {
+            bytes.push_back(bitBuffer & 0xff);
+        }
+        bitBuffer = 0;
+        bitCount = 0;
+    }
+
+  private:
+    uint64_t bitBuffer = 0;
+    int bitCount = 0;
+};
+
+const int lengthBase[29] = {3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,195,227,258};
+const int lengthExtraBits[29] = {0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0};
+const int distanceBase[30] = {1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,1025,1537,2049,3073,
+                              4097,6145,8193,12289,16385,24577};
+const int distanceExtraBits[30] = {0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13};
+
+#define DEFLATE_WINDOW 32768
+#define DEFLATE_MIN_MATCH 3
+#define DEFLATE_MAX_MATCH 258
+#define DEFLATE_HASH_BITS 15
+#define DEFLATE_MAX_CHAIN 32
+
+void writeLiteralOrLength(BitWriter &bits, int symbol) {
+    if(symbol < 144)
+        bits.writeCode(0x30 + symbol, 8);
+    else if(symbol < 256)
+        bits.writeCode(0x190 + symbol - 144, 9);
+    else if(symbol < 280)
+        bits.writeCode(symbol - 256, 7);
+    else
+        bits.writeCode(0xc0 + symbol - 280, 8);
+}
+
+int findCode(const int *base, int numCodes, int value) {
+    int code = numCodes - 1;
+    while(base[code] > value) code--;
+    return code;
+}
+
+void writeMatch(BitWriter &bits, int length, int distance) {
+    int lengthCode = findCode(lengthBase, 29, length);
+    writeLiteralOrLength(bits, 257 + lengthCode);
+    bits.writeBits(length - lengthBase[lengthCode], lengthExtraBits[lengthCode]);
+    int distanceCode = findCode(distanceBase, 30, distance);
+    bits.writeCode(distanceCode, 5);
+    bits.writeBits(distance - distanceBase[distanceCode], distanceExtraBits[distanceCode]);
+}
+
+// Appends the deflated data to bits
+void deflate(const vector<unsigned char> &data, BitWriter &bits) {
+    bits.writeBits(1, 1); // Final block
+    bits.writeBits(1, 2); // Fixed Huffman codes
+    size_t size = data.size();
+    vector<int> head(1 << DEFLATE_HASH_BITS, -1);
+    // Matches reach at most DEFLATE_WINDOW back, so the chains only need that many entries.
+    // The chain is left before it reaches a position whose entry was reused.
+    vector<int> previous(DEFLATE_WINDOW, -1);
+    auto hashAt = [&](size_t pos) {
+        uint32_t key = data[pos] | (data[pos+1] << 8) | (data[pos+2] << 16);
+        return (key * 2654435761u) >> (32 - DEFLATE_HASH_BITS);
+    };
+    auto insert = [&](size_t pos) {
+        if(pos + DEFLATE_MIN_MATCH > size) return;
+        uint32_t hash = hashAt(pos);
+        previous[pos & (DEFLATE_WINDOW - 1)] = head[hash];
+        head[hash] = pos;
+    };
+    size_t pos = 0;
+    while(pos < size) {
+        int bestLength = 0;
+        int bestDistance = 0;
+        if(pos + DEFLATE_MIN_MATCH <= size) {
+            int maxLength = min<size_t>(DEFLATE_MAX_MATCH, size - pos);
+            int candidate = head[hashAt(pos)];
+            for(int chain = 0; candidate >= 0 && pos - candidate <= DEFLATE_WINDOW && chain < DEFLATE_MAX_CHAIN; chain++) {
+                int length = 0;
+                while(length < maxLength && data[candidate + length] == data[pos + length]) length++;
+                if(length > bestLength) {
+                    bestLength = length;
+                    bestDistance = pos - candidate;
+                    if(length == maxLength) break;
+                }
+                candidate = previous[candidate & (DEFLATE_WINDOW - 1)];
+            }
+        }
+        if(bestLength >= DEFLATE_MIN_MATCH) {
+            writeMatch(bits, bestLength, bestDistance);
+            for(int i = 0; i < bestLength; i++) insert(pos + i);
+            pos += bestLength;
+        } else {
+            writeLiteralOrLength(bits, data[pos]);
+            insert(pos);
+            pos++;
+        }
+    }
+    writeLiteralOrLength(bits, 256); // End of block
+    bits.flush();
+}
+
+uint32_t adler32(const vector<unsigned char> &data) {
+    uint32_t a = 1, b = 0;
+    for(unsigned char byte: data) {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    return (b << 16) | a;
+}
+
+vector<uint32_t> buildCRCTable() {
+    vector<uint32_t> table(256);
+    for(uint32_t n = 0; n < 256; n++) {
+        uint32_t c = n;
+        for(int k = 0; k < 8; k++)
+            c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        table[n] = c;
+    }
+    return table;
+}
+
+uint32_t crc32(const unsigned char *data, size_t size, uint32_t crc = 0) {
+    static const vector<uint32_t> table = buildCRCTable();
+    crc = ~crc;
+    for(size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+void storeBigEndian(unsigned char *bytes, uint32_t value) {
+    for(int byte = 0; byte < 4; byte++) {
+        bytes[byte] = (value >> (24 - 8*byte)) & 0xff;
+    }
+}
+
+// The CRC covers the type and the data, which are written as they are
+void writeChunk(ostream &output, const char *type, const unsigned char *data, size_t size) {
+    unsigned char start[8];
+    storeBigEndian(start, size);
+    memcpy(start + 4, type, 4);
+    output.write(reinterpret_cast<const char *>(start), 8);
+    output.write(reinterpret_cast<const char *>(data), size);
+    unsigned char crc[4];
+    storeBigEndian(crc, crc32(data, size, crc32(start + 4, 4)));
+    output.write(reinterpret_cast<const char *>(crc), 4);
+}
+
+int paethPredictor(int left, int up, int upLeft) {
+    int estimate = left + up - upLeft;
+    int distLeft = abs(estimate - left);
+    int distUp = abs(estimate - up);
+    int distUpLeft = abs(estimate - upLeft);
+    if(distLeft <= distUp && distLeft <= distUpLeft) return left;
+    return distUp <= distUpLeft ? up : upLeft;
+}
+
+// Picks the row filter whose output has the smallest sum of absolute (signed) bytes,
+// the heuristic suggested by the PNG specification
+void appendFilteredRow(vector<unsigned char> &output, const vector<unsigned char> &row, const vector<unsigned char> &above) {
+    const int bytesPerPixel = 3;
+    vector<unsigned char> best;
+    long bestScore = -1;
+    int bestFilter = 0;
+    for(int filter = 0; filter < 5; filter++) {
+        vector<unsigned char> filtered(row.size());
+        long score = 0;
+        for(size_t i = 0; i < row.size(); i++) {
+            int left = i >= bytesPerPixel ? row[i - bytesPerPixel] : 0;
+            int up = above[i];
+            int upLeft = i >= bytesPerPixel ? above[i - bytesPerPixel] : 0;
+            int predicted = 0;
+            if(filter == 1) predicted = left;
+            if(filter == 2) predicted = up;
+            if(filter == 3) predicted = (left + up) / 2;
+            if(filter == 4) predicted = paethPredictor(left, up, upLeft);
+            filtered[i] = row[i] - predicted;
+            score += abs(static_cast<signed char>(filtered[i]));
+        }
+        if(bestScore < 0 || score < bestScore) {
+            bestScore = score;
+            bestFilter = filter;
+            best.swap(filtered);
+        }
+    }
+    output.push_back(bestFilter);
+    output.insert(output.end(), best.begin(), best.end());
+}
+
+void PNGWriter::write(const Framebuffer &image, ostream &output) const {
+    const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    output.write(reinterpret_cast<const char *>(signature), 8);
+
+    unsigned char header[13];
+    storeBigEndian(header, image.width);
+    storeBigEndian(header + 4, image.height);
+    header[8] = 8;  // Bits per channel
+    header[9] = 2;  // RGB
+    header[10] = 0; // Deflate
+    header[11] = 0; // Adaptive row filters
+    header[12] = 0; // Not interlaced
+    writeChunk(output, "IHDR", header, sizeof(header));
+
+    vector<unsigned char> scanlines;
+    scanlines.reserve((3*image.width + 1)*image.height);
+    vector<unsigned char> above(3*image.width, 0);
+    for(long y = 0; y < image.height; y++) {
+        vector<unsigned char> row = rowToBytes(image, y);
+        appendFilteredRow(scanlines, row, above);
+        above.swap(row);
+    }
+    // A zlib stream: its header, the deflated scanlines and their checksum
+    BitWriter compressed;
+    compressed.bytes = {0x78, 0x01};
+    deflate(scanlines, compressed);
+    uint32_t checksum = adler32(scanlines);
+    for(int shift = 24; shift >= 0; shift -= 8) {
+        compressed.bytes.push_back((checksum >> shift) & 0xff);
+    }
+    writeChunk(output, "IDAT", compressed.bytes.data(), compressed.bytes.size());
+    writeChunk(output, "IEND", nullptr, 0);
+}
+
+string fileExtension(const string &fileName) {
+    size_t dot = fileName.find_last_of('.');
+    size_t slash = fileName.find_last_of('/');
+    if(dot == string::npos || (slash != string::npos && dot < slash)) return "";
+    string extension = fileName.substr(dot + 1);
+    transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension;
+}
+
+unique_ptr<ImageWriter> imageWriterFor(const string &fileName, const string &format) {
+    string type = format.empty() ? fileExtension(fileName) : format;
+    if(type == "p3")
+        return unique_ptr<ImageWriter>(new AsciiPPMWriter);
+    if(type == "png")
+        return unique_ptr<ImageWriter>(new PNGWriter);
+    if(type == "pfm")
+        return unique_ptr<ImageWriter>(new PFMWriter);
+    if(type == "p6" || format.empty())
+        return unique_ptr<ImageWriter>(new BinaryPPMWriter);
+    throw string("Unknown image format " + format + ", expected p3, p6, png or pfm");
+}
+
+// The temporary file is renamed over the output, so a viewer never sees half an image
+bool saveImage(const ImageWriter &writer, const Framebuffer &image, const string &outputFile) {
+    string temporaryFile = outputFile + ".tmp";
+    ofstream output(temporaryFile, ofstream::trunc | ofstream::binary);
+    writer.write(image, output);
+    output.close();
+    if(!output || rename(temporaryFile.c_str(), outputFile.c_str()) != 0) {
+        remove(temporaryFile.c_str());
+        return false;
+    }
+    return true;
+}
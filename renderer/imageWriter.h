@@ -0,0 +1,54 @@
+#ifndef IMAGE_WRITER_H
+#define IMAGE_WRITER_H
+
+#include "framebuffer.h"
+#include <Eigen/Dense>
+#include <ostream>
+#include <string>
+#include <memory>
+
+class ImageWriter {
+  public:
+    virtual void write(const Framebuffer &image, std::ostream &output) const = 0;
+    virtual std::string formatName() const = 0;
+    virtual ~ImageWriter() = default;
+};
+
+// ASCII PPM, kept for compatibility with the original output
+class AsciiPPMWriter: public ImageWriter {
+  public:
+    void write(const Framebuffer &image, std::ostream &output) const;
+    std::string formatName() const { return "P3 (ASCII PPM)"; }
+};
+
+class BinaryPPMWriter: public ImageWriter {
+  public:
+    void write(const Framebuffer &image, std::ostream &output) const;
+    std::string formatName() const { return "P6 (binary PPM)"; }
+};
+
+// 8 bit RGB PNG, compressed with a built in deflate encoder
+class PNGWriter: public ImageWriter {
+  public:
+    void write(const Framebuffer &image, std::ostream &output) const;
+    std::string formatName() const { return "PNG"; }
+};
+
+// Portable float map, which keeps the unclamped high dynamic range colours
+class PFMWriter: public ImageWriter {
+  public:
+    void write(const Framebuffer &image, std::ostream &output) const;
+    std::string formatName() const { return "PFM"; }
+};
+
+// format is one of p3, p6, png or pfm. If it is empty, the format is picked from the
+// file extension, with anything unrecognised written as a binary PPM.
+std::unique_ptr<ImageWriter> imageWriterFor(const std::string &fileName, const std::string &format);
+
+// Writes image to outputFile in the writer's format, under another name first so that the
+// file always holds a whole image. Returns false if it couldn't be written.
+bool saveImage(const ImageWriter &writer, const Framebuffer &image, const std::string &outputFile);
+
+std::string floatToIntColorString(const Eigen::Vector3d &color);
+
+#endif
@@ -0,0 +1,348 @@
+#include "parallelRenderer.h"
+#include "tileScheduler.h"
+#include "shading.h"
+#include "../environment/environment.h"
+#include "../dataStructures/simd.h"
+#include "renderOptions.h"
+#include "renderContext.h"
+#include "wavefrontIntegrator.h"
+#include <Eigen/Dense>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+
+using namespace std;
+using namespace Eigen;
+
+ParallelRenderer::ParallelRenderer(const Environment &env, const RenderOptions &options)
+    : env(env), numThreads(options.threadCount()), tileSize(options.tileSize), usePackets(options.usePackets),
+      aaSamples(options.aaSamples), aaThreshold(options.aaThreshold), progressive(options.progressive),
+      wavefront(options.wavefront), sortRays(options.sortRays) {}
+
+bool ParallelRenderer::pastDeadline() const {
+    return chrono::steady_clock::now() >= deadline;
+}
+
+void ParallelRenderer::renderTile(const Tile &tile, Framebuffer &image, RenderContext &context, long originX,
+                                  long originY) const {
+    if(wavefront) {
+        renderTileWavefront(tile, image, context, originX, originY);
+        return;
+    }
+    for(long y = tile.y0; y < tile.y1; y++) {
+        if(usePackets) {
+            for(long x = tile.x0; x < tile.x1; x += SIMD_WIDTH) {
+                int count = min<long>(SIMD_WIDTH, tile.x1 - x);
+                Vector3r colors[SIMD_WIDTH];
+                pixelPacketToColors(x, y, count, context, colors);
+                for(int i = 0; i < count; i++) {
+                    image.setPixel(x + i - originX, y - originY, colors[i]);
+                }
+            }
+        } else {
+            for(long x = tile.x0; x < tile.x1; x++) {
+                image.setPixel(x - originX, y - originY, pixelToColor(x, y, context));
+            }
+        }
+    }
+}
+
+void ParallelRenderer::renderTileWavefront(const Tile &tile, Framebuffer &image, RenderContext &context,
+                                           long originX, long originY) const {
+    long width = tile.x1 - tile.x0;
+    vector<Vector3r> colors(width*(tile.y1 - tile.y0), Vector3r(0,0,0));
+    WavefrontIntegrator integrator(context, sortRays);
+    for(long y = tile.y0; y < tile.y1; y++) {
+        for(long x = tile.x0; x < tile.x1; x++) {
+            context.beginPixel(x, y);
+            integrator.addCameraRay(x, y, context.random, (y - tile.y0)*width + x - tile.x0, 1);
+        }
+    }
+    integrator.trace(colors, usePackets);
+    for(long y = tile.y0; y < tile.y1; y++) {
+        for(long x = tile.x0; x < tile.x1; x++) {
+            image.setPixel(x - originX, y - originY, colors[(y - tile.y0)*width + x - tile.x0]);
+        }
+    }
+}
+
+void ParallelRenderer::supersampleTileWavefront(const Tile &tile, const vector<char> &edges, Framebuffer &image,
+                                                RenderContext &context) const {
+    vector<long> pixels;
+    vector<Vector2r> points;
+    WavefrontIntegrator integrator(context, sortRays);
+    for(long y = tile.y0; y < tile.y1; y++) {
+        for(long x = tile.x0; x < tile.x1; x++) {
+            if(!edges[y*env.xRes + x]) continue;
+            context.beginPixel(x, y);
+            pixelSamplePoints(x, y, aaSamples, context.random, points);
+            // Each sample gets a generator of its own, seeded from the pixel's, since copies of
+            // one generator a draw apart would pick nearly the same lights
+            for(const Vector2r &point: points) {
+                integrator.addCameraRay(point(0), point(1), Random(context.random.next()), pixels.size(),
+                                        Real(1) / aaSamples);
+            }
+            pixels.push_back(y*env.xRes + x);
+        }
+    }
+    vector<Vector3r> colors(pixels.size(), Vector3r(0,0,0));
+    integrator.trace(colors, false);
+    for(size_t i = 0; i < pixels.size(); i++) {
+        image.setPixel(pixels[i] % env.xRes, pixels[i] / env.xRes, colors[i]);
+    }
+}
+
+vector<char> ParallelRenderer::findEdges(const Framebuffer &image) const {
+    vector<char> edges(image.width*image.height, 0);
+    auto displayed = [&](long x, long y) -> Vector3d {
+        return image.getPixel(x, y).cwiseMax(0.0).cwiseMin(1.0);
+    };
+    for(long y = 0; y < image.height; y++) {
+        for(long x = 0; x < image.width; x++) {
+            Vector3d color = displayed(x, y);
+            // Each pair of neighbours is compared once, and both are marked
+            const long offsets[4][2] = {{1, 0}, {-1, 1}, {0, 1}, {1, 1}};
+            for(const long *offset: offsets) {
+                long nx = x + offset[0], ny = y + offset[1];
+                if(nx < 0 || nx >= image.width || ny >= image.height) continue;
+                if((displayed(nx, ny) - color).cwiseAbs().maxCoeff() > aaThreshold) {
+                    edges[y*image.width + x] = 1;
+                    edges[ny*image.width + nx] = 1;
+                }
+            }
+        }
+    }
+    return edges;
+}
+
+void ParallelRenderer::render(Framebuffer &image, const function<void(double)> &progress) {
+    image = Framebuffer(env.xRes, env.yRes);
+    counters = RenderCounters();
+    antialiasedPixels = 0;
+    passesDone = 0;
+    stoppedAtDeadline = false;
+    if(progressive) {
+        renderProgressive(image, progress);
+        return;
+    }
+    vector<Tile> tiles = splitIntoTiles(env.xRes, env.yRes, tileSize);
+    bool antialias = aaSamples > 1;
+    // How many pixels the second pass traces isn't known until the first is done, so each
+    // pass is reported as half of the work
+    renderPass(tiles, [&](const Tile &tile, RenderContext &context) {
+        renderTile(tile, image, context);
+    }, progress, 0, antialias ? 0.5 : 1);
+    if(!antialias) return;
+
+    vector<char> edges = findEdges(image);
+    for(char edge: edges) {
+        antialiasedPixels += edge;
+    }
+    renderPass(tiles, [&](const Tile &tile, RenderContext &context) {
+        if(wavefront) {
+            supersampleTileWavefront(tile, edges, image, context);
+            return;
+        }
+        for(long y = tile.y0; y < tile.y1; y++) {
+            for(long x = tile.x0; x < tile.x1; x++) {
+                if(edges[y*env.xRes + x]) {
+                    image.setPixel(x, y, supersamplePixel(x, y, aaSamples, context));
+                }
+            }
+        }
+    }, progress, 0.5, 1);
+}
+
+void ParallelRenderer::renderTiles(const vector<Tile> &tiles,
+                                   const function<void(const Tile &, const Framebuffer &)> &tileDone) {
+    renderPass(tiles, [&](const Tile &tile, RenderContext &context) {
+        Framebuffer tileImage(tile.x1 - tile.x0, tile.y1 - tile.y0);
+        renderTile(tile, tileImage, context, tile.x0, tile.y0);
+        tileDone(tile, tileImage);
+    }, [](double) {}, 0, 1);
+}
+
+// Objects hit by the marked pixels of one tile, in the order the pixels were rendered
+class TileObjects {
+  public:
+    vector<size_t> counts;
+    vector<const SceneObject *> objects;
+};
+
+void ParallelRenderer::renderPixels(Framebuffer &image, const vector<char> &pixels, PixelObjects &objectsHit) {
+    counters = RenderCounters();
+    long pixelCount = env.xRes*env.yRes;
+    if(objectsHit.offsets.size() != size_t(pixelCount + 1)) {
+        objectsHit.offsets.assign(pixelCount + 1, 0);
+        objectsHit.objects.clear();
+    }
+    vector<Tile> tiles = splitIntoTiles(env.xRes, env.yRes, tileSize);
+    long tilesAcross = (env.xRes + tileSize - 1) / tileSize;
+    vector<TileObjects> tileObjects(tiles.size());
+    renderPass(tiles, [&](const Tile &tile, RenderContext &context) {
+        TileObjects &found = tileObjects[(tile.y0 / tileSize)*tilesAcross + tile.x0 / tileSize];
+        vector<const SceneObject *> hits;
+        context.objectsHit = &hits;
+        for(long y = tile.y0; y < tile.y1; y++) {
+            for(long x = tile.x0; x < tile.x1; x++) {
+                if(!pixels[y*env.xRes + x]) continue;
+                hits.clear();
+                image.setPixel(x, y, pixelToColor(x, y, context));
+                sort(hits.begin(), hits.end());
+                hits.erase(unique(hits.begin(), hits.end()), hits.end());
+                found.counts.push_back(hits.size());
+                found.objects.insert(found.objects.end(), hits.begin(), hits.end());
+            }
+        }
+        context.objectsHit = nullptr;
+    }, [](double) {}, 0, 1);
+
+    // Image order visits the pixels of each tile in the order they were rendered, so every
+    // tile's objects are taken from the front. Tiles skipped past the deadline keep their
+    // old objects, as they keep their old pixels.
+    PixelObjects merged;
+    merged.offsets.reserve(pixelCount + 1);
+    merged.offsets.push_back(0);
+    merged.objects.reserve(objectsHit.objects.size());
+    vector<size_t> nextCount(tiles.size(), 0), nextObject(tiles.size(), 0);
+    for(long y = 0; y < env.yRes; y++) {
+        for(long x = 0; x < env.xRes; x++) {
+            long pixel = y*env.xRes + x;
+            size_t t = (y / tileSize)*tilesAcross + x / tileSize;
+            const TileObjects &found = tileObjects[t];
+            if(pixels[pixel] && nextCount[t] < found.counts.size()) {
+                auto first = found.objects.begin() + nextObject[t];
+                size_t count = found.counts[nextCount[t]++];
+                merged.objects.insert(merged.objects.end(), first, first + count);
+                nextObject[t] += count;
+            } else {
+                merged.objects.insert(merged.objects.end(), objectsHit.begin(pixel), objectsHit.end(pixel));
+            }
+            merged.offsets.push_back(merged.objects.size());
+        }
+    }
+    swap(objectsHit, merged);
+}
+
+void ParallelRenderer::renderPass(const vector<Tile> &tiles, const function<void(const Tile &, RenderContext &)> &work,
+                                  const function<void(double)> &progress, double progressStart, double progressEnd) {
+    TileScheduler scheduler(tiles, numThreads);
+
+    atomic<size_t> tilesDone(0);
+    // Tiles skipped past the deadline are done but not rendered, and don't count as progress
+    atomic<size_t> tilesRendered(0);
+    mutex doneLock;
+    condition_variable allDone;
+
+    mutex countersLock;
+    vector<thread> workers;
+    for(int worker = 0; worker < numThreads; worker++) {
+        workers.emplace_back([&, worker]() {
+            RenderContext context(env);
+            traversalCounters() = TraversalCounters();
+            Tile tile;
+            while(scheduler.nextTile(worker, tile)) {
+                // Tiles past the deadline are still taken, so the pass ends as usual
+                if(!pastDeadline()) {
+                    work(tile, context);
+                    tilesRendered++;
+                }
+                if(++tilesDone == tiles.size()) {
+                    lock_guard<mutex> guard(doneLock);
+                    allDone.notify_all();
+                }
+            }
+            context.counters.traversal += traversalCounters();
+            lock_guard<mutex> guard(countersLock);
+            counters += context.counters;
+        });
+    }
+
+    unique_lock<mutex> waitLock(doneLock);
+    while(tilesDone < tiles.size()) {
+        allDone.wait_for(waitLock, chrono::milliseconds(250));
+        progress(progressStart + (progressEnd - progressStart) * tilesRendered / tiles.size());
+    }
+    waitLock.unlock();
+    for(thread &worker: workers) {
+        worker.join();
+    }
+    stoppedAtDeadline = stoppedAtDeadline || pastDeadline();
+}
+
+#define PROGRESSIVE_FIRST_STEP 8
+
+// Pixels traced by the coarse to fine pass with the given step: those on its grid which
+// weren't on the grid of the pass before
+bool tracedInPass(long x, long y, long step) {
+    return x % step == 0 && y % step == 0
+        && (step == PROGRESSIVE_FIRST_STEP || x % (2*step) != 0 || y % (2*step) != 0);
+}
+
+void ParallelRenderer::renderProgressive(Framebuffer &image, const function<void(double)> &progress) {
+    vector<Tile> tiles = splitIntoTiles(env.xRes, env.yRes, tileSize);
+    vector<long> passPixels;
+    for(long step = PROGRESSIVE_FIRST_STEP; step >= 1; step /= 2) {
+        long count = 0;
+        for(long y = 0; y < env.yRes; y += step) {
+            for(long x = 0; x < env.xRes; x += step) {
+                count += tracedInPass(x, y, step);
+            }
+        }
+        passPixels.push_back(count);
+    }
+    int coarsePasses = passPixels.size();
+    for(int sample = 1; sample < aaSamples; sample++) {
+        passPixels.push_back(env.xRes*env.yRes);
+    }
+    totalPasses = passPixels.size();
+    double totalPixels = 0;
+    for(long count: passPixels) {
+        totalPixels += count;
+    }
+
+    // Sums of every ray traced through each pixel, averaged into the image
+    vector<Vector3r> sums(env.xRes*env.yRes, Vector3r(0,0,0));
+    double pixelsDone = 0;
+    for(int pass = 0; pass < totalPasses && !stoppedAtDeadline; pass++) {
+        // Coarse to fine passes have a step, the ones after add the given sample
+        long step = PROGRESSIVE_FIRST_STEP >> pass;
+        int sample = pass - coarsePasses + 1;
+        renderPass(tiles, [&](const Tile &tile, RenderContext &context) {
+            for(long y = tile.y0; y < tile.y1; y++) {
+                for(long x = tile.x0; x < tile.x1; x++) {
+                    Vector3r &sum = sums[y*env.xRes + x];
+                    if(step >= 1) {
+                        if(!tracedInPass(x, y, step)) continue;
+                        sum = pixelToColor(x, y, context);
+                        // Fill the block this pixel stands for until finer passes trace it
+                        for(long by = y; by < min(y + step, env.yRes); by++) {
+                            for(long bx = x; bx < min(x + step, env.xRes); bx++) {
+                                image.setPixel(bx, by, sum);
+                            }
+                        }
+                    } else {
+                        context.beginPixel(x, y, sample);
+                        Real offsetX = context.random.uniform() - Real(0.5);
+                        Real offsetY = context.random.uniform() - Real(0.5);
+                        Ray ray = primaryRay(x + offsetX, y + offsetY, env);
+                        sum += pixelToColorVector(ray, context, env.recursionLevel);
+                        image.setPixel(x, y, sum / (sample + 1));
+                    }
+                }
+            }
+        }, progress, pixelsDone / totalPixels, (pixelsDone + passPixels[pass]) / totalPixels);
+        pixelsDone += passPixels[pass];
+        if(!stoppedAtDeadline) {
+            passesDone++;
+        }
+        if(passDone) {
+            passDone(image);
+        }
+    }
+}
@@ -0,0 +1,103 @@
+#ifndef PARALLEL_RENDERER_H
+#define PARALLEL_RENDERER_H
+
+#include "../environment/environment.h"
+#include "tileScheduler.h"
+#include "framebuffer.h"
+#include "renderContext.h"
+#include "renderOptions.h"
+#include <Eigen/Dense>
+#include <vector>
+#include <functional>
+#include <chrono>
+
+// Objects hit by the rays of each pixel, stored flat instead of in a vector per pixel: the
+// objects of pixel p, sorted by address, run from objects[offsets[p]] to objects[offsets[p + 1]]
+class PixelObjects {
+  public:
+    std::vector<size_t> offsets;
+    std::vector<const SceneObject *> objects;
+
+    bool empty(long pixel) const { return offsets[pixel] == offsets[pixel + 1]; }
+    const SceneObject *const *begin(long pixel) const { return objects.data() + offsets[pixel]; }
+    const SceneObject *const *end(long pixel) const { return objects.data() + offsets[pixel + 1]; }
+};
+
+// Renders the image as tiles spread over a pool of worker threads. Every pixel is traced
+// independently, so the result doesn't depend on the number of threads. Primary ray
+// packets visit objects in another order than single rays, so where two surfaces are hit
+// within the intersection tolerance of each other, such as the seams between walls, a
+// packet may pick the other surface than --no-packets does.
+//
+// The wavefront integrator traces each tile as queues of rays instead of pixel by pixel.
+//
+// With anti-aliasing, a first pass traces one ray through the centre of every pixel, and
+// a second pass supersamples only the pixels which differ from a neighbour by more than
+// the threshold.
+//
+// Progressive renders go from coarse to fine instead: the first pass traces every 8th
+// pixel of every 8th row and fills the blocks around them, and each following pass
+// halves the block size until every pixel is traced. With anti-aliasing, further passes
+// then add one randomly placed ray to every pixel until each has aaSamples. Tiles
+// started after the deadline are skipped, which leaves the best image so far.
+class ParallelRenderer {
+  public:
+    ParallelRenderer(const Environment &env, const RenderOptions &options);
+
+    // Fills image with xRes by yRes pixels. progress is called on the calling thread
+    // with the fraction of the work finished while the workers run.
+    void render(Framebuffer &image, const std::function<void(double)> &progress);
+    // Renders just the given tiles, each into an image of its own size which is passed to
+    // tileDone on the worker thread which finished it. Counters add up over calls.
+    void renderTiles(const std::vector<Tile> &tiles,
+                     const std::function<void(const Tile &, const Framebuffer &)> &tileDone);
+    // Renders just the pixels marked in pixels into image, which must already be xRes by
+    // yRes, with one ray each and no packets, as --no-packets would. objectsHit gets the
+    // objects hit by the rays of each pixel rendered and keeps those of the others; if it
+    // isn't for xRes by yRes pixels, they start out with none.
+    void renderPixels(Framebuffer &image, const std::vector<char> &pixels, PixelObjects &objectsHit);
+
+    // Summed over every thread of the last render
+    RenderCounters counters;
+    long antialiasedPixels = 0;
+
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    // Called on the calling thread with the image after each progressive pass
+    std::function<void(const Framebuffer &)> passDone;
+    // Progressive passes planned and finished so far, for progress reports
+    int totalPasses = 1;
+    int passesDone = 0;
+    bool stoppedAtDeadline = false;
+
+  private:
+    // Runs work on every tile, reporting progress as the fraction of tiles done scaled
+    // into [progressStart, progressEnd]
+    void renderPass(const std::vector<Tile> &tiles,
+                    const std::function<void(const Tile &, RenderContext &)> &work,
+                    const std::function<void(double)> &progress, double progressStart, double progressEnd);
+    // image holds the pixels from (originX, originY) on
+    void renderTile(const Tile &tile, Framebuffer &image, RenderContext &context, long originX = 0,
+                    long originY = 0) const;
+    void renderTileWavefront(const Tile &tile, Framebuffer &image, RenderContext &context, long originX,
+                             long originY) const;
+    void supersampleTileWavefront(const Tile &tile, const std::vector<char> &edges, Framebuffer &image,
+                                  RenderContext &context) const;
+    void renderProgressive(Framebuffer &image, const std::function<void(double)> &progress);
+    bool pastDeadline() const;
+    // Marks the pixels whose colour differs from one of their eight neighbours by more
+    // than aaThreshold in any channel, on the 0-1 scale the image is written in
+    std::vector<char> findEdges(const Framebuffer &image) const;
+
+    const Environment &env;
+    int numThreads;
+    int tileSize;
+    // Trace primary rays in SIMD packets along each row of a tile
+    bool usePackets;
+    int aaSamples;
+    double aaThreshold;
+    bool progressive;
+    bool wavefront;
+    bool sortRays;
+};
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef RENDER_CONTEXT_H
+#define RENDER_CONTEXT_H
+
+#include "../environment/environment.h"
+#include "../sceneObjects/sceneObject.h"
+#include "../dataStructures/random.h"
+#include "../dataStructures/traversalCounters.h"
+#include <vector>
+#include <cstdint>
+
+// Recursion depths counted separately, the last one counting every deeper ray too
+#define RENDER_DEPTH_BUCKETS 16
+
+// Counts kept by each render thread and summed once the render is done
+class RenderCounters {
+  public:
+    long primaryRays = 0;
+    long reflectionRays = 0;
+    long refractionRays = 0;
+    long shadowRays = 0;
+    long blockedShadowRays = 0;
+    // Lights behind the surface, which need no shadow ray
+    long culledShadowRays = 0;
+    long occluderCacheLookups = 0;
+    long occluderCacheHits = 0;
+    // Primary, reflection and refraction rays traced at each recursion depth
+    long raysAtDepth[RENDER_DEPTH_BUCKETS] = {};
+    TraversalCounters traversal;
+
+    RenderCounters &operator+=(const RenderCounters &other) {
+        primaryRays += other.primaryRays;
+        reflectionRays += other.reflectionRays;
+        refractionRays += other.refractionRays;
+        shadowRays += other.shadowRays;
+        blockedShadowRays += other.blockedShadowRays;
+        culledShadowRays += other.culledShadowRays;
+        occluderCacheLookups += other.occluderCacheLookups;
+        occluderCacheHits += other.occluderCacheHits;
+        for(int depth = 0; depth < RENDER_DEPTH_BUCKETS; depth++) {
+            raysAtDepth[depth] += other.raysAtDepth[depth];
+        }
+        traversal += other.traversal;
+        return *this;
+    }
+};
+
+// The object and primitive which last blocked a shadow ray towards a light
+class Occluder {
+  public:
+    const SceneObject *object = nullptr;
+    int primitive = 0;
+};
+
+// State one render thread carries through the shading of its pixels. The random numbers
+// are reseeded for every pixel, so an image doesn't depend on which thread rendered what.
+class RenderContext {
+  public:
+    explicit RenderContext(const Environment &env): env(env), lastOccluders(env.lightSources.size()) {}
+
+    const Environment &env;
+    Random random;
+    // Neighbouring points are usually shadowed from a light by the same primitive, so it
+    // is tested before searching the scene
+    std::vector<Occluder> lastOccluders;
+    RenderCounters counters;
+    // If set, every object a shaded ray hits is added to it
+    std::vector<const SceneObject *> *objectsHit = nullptr;
+
+    // Later samples of a pixel, traced by separate progressive passes, get their own seeds
+    void beginPixel(long x, long y, int sample = 0) {
+        random.seed((uint64_t(sample)*env.yRes + y)*env.xRes + x);
+    }
+};
+
+#endif
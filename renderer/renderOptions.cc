@@ -0,0 +1,170 @@
+#include "renderOptions.h"
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cerrno>
+#include <climits>
+#include <thread>
+
+using namespace std;
+
+double parsePositiveDouble(const string &option, const string &value) {
+    char *end;
+    double parsed = strtod(value.c_str(), &end);
+    if(value.empty() || *end != '\0' || !(parsed > 0)) {
+        throw string("Option " + option + " expects a positive number, got \"" + value + "\"");
+    }
+    return parsed;
+}
+
+int parsePositiveInt(const string &option, const string &value) {
+    char *end;
+    errno = 0;
+    long parsed = strtol(value.c_str(), &end, 10);
+    // Anything beyond an int would wrap around when narrowed to one
+    if(value.empty() || *end != '\0' || parsed < 1 || errno == ERANGE || parsed > INT_MAX) {
+        throw string("Option " + option + " expects a positive integer, got \"" + value + "\"");
+    }
+    return parsed;
+}
+
+// TCP ports are 16 bits, so larger ones would wrap around to another port
+int parsePort(const string &option, const string &value) {
+    int port = parsePositiveInt(option, value);
+    if(port > 65535) {
+        throw string("Option " + option + " expects a port from 1 to 65535, got \"" + value + "\"");
+    }
+    return port;
+}
+
+RenderOptions::RenderOptions(int argc, char **argv) {
+    vector<string> positional;
+    string integrator;
+    for(int i = 1; i < argc; i++) {
+        const string arg(argv[i]);
+        if(arg == "--threads" || arg == "--tile-size" || arg == "--aa-samples" || arg == "--coordinator") {
+            if(i + 1 >= argc) {
+                throw string("Option " + arg + " is missing its value");
+            }
+            int value = arg == "--coordinator" ? parsePort(arg, argv[++i]) : parsePositiveInt(arg, argv[++i]);
+            if(arg == "--threads")
+                numThreads = value;
+            else if(arg == "--tile-size")
+                tileSize = value;
+            else if(arg == "--coordinator")
+                coordinatorPort = value;
+            else
+                aaSamples = value;
+        } else if(arg == "--aa-threshold" || arg == "--time-budget") {
+            if(i + 1 >= argc) {
+                throw string("Option " + arg + " is missing its value");
+            }
+            double value = parsePositiveDouble(arg, argv[++i]);
+            if(arg == "--aa-threshold") {
+                aaThreshold = value;
+            } else {
+                // Only a progressive render has an image worth keeping when time runs out
+                timeBudget = value;
+                progressive = true;
+            }
+        } else if(arg == "--integrator") {
+            if(i + 1 >= argc) {
+                throw string("Option " + arg + " is missing its value");
+            }
+            integrator = argv[++i];
+            if(integrator != "recursive" && integrator != "wavefront") {
+                throw string("Unknown integrator " + integrator + ", expected recursive or wavefront");
+            }
+            wavefront = integrator == "wavefront";
+        } else if(arg == "--worker") {
+            if(i + 1 >= argc) {
+                throw string("Option " + arg + " is missing its value");
+            }
+            string address = argv[++i];
+            size_t colon = address.rfind(':');
+            if(colon == string::npos || colon == 0) {
+                throw string("Option " + arg + " expects host:port, got \"" + address + "\"");
+            }
+            workerHost = address.substr(0, colon);
+            workerPort = parsePort(arg, address.substr(colon + 1));
+        } else if(arg == "--format" || arg == "--mesh-cache" || arg == "--serve") {
+            if(i + 1 >= argc) {
+                throw string("Option " + arg + " is missing its value");
+            }
+            if(arg == "--format")
+                format = argv[++i];
+            else if(arg == "--serve")
+                serveSocket = argv[++i];
+            else
+                meshCacheDirectory = argv[++i];
+        } else if(arg == "--no-packets") {
+            usePackets = false;
+        } else if(arg == "--oct-normals") {
+            octNormals = true;
+        } else if(arg == "--rebuild-bvh") {
+            rebuildBVH = true;
+        } else if(arg == "--sort-rays") {
+            sortRays = true;
+        } else if(arg == "--progressive") {
+            progressive = true;
+        } else if(arg == "--stats" || arg == "--stats=text") {
+            printStats = true;
+        } else if(arg == "--stats=json") {
+            printStats = true;
+            statsJson = true;
+        } else if(arg.size() > 2 && arg.substr(0, 2) == "--") {
+            throw string("Unknown option " + arg);
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    // Sorting needs the queues of rays the wavefront integrator keeps
+    if(sortRays) {
+        if(integrator == "recursive") {
+            throw string("Option --sort-rays needs the wavefront integrator");
+        }
+        wavefront = true;
+    }
+    if(wavefront && progressive) {
+        throw string("The wavefront integrator can't render progressively");
+    }
+    // Anti-aliasing and progressive passes need the whole image between passes
+    if(coordinatorPort > 0 || !workerHost.empty()) {
+        if(coordinatorPort > 0 && !workerHost.empty()) {
+            throw string("A process can't be both a coordinator and a worker");
+        }
+        if(aaSamples > 1 || progressive) {
+            throw string("Distributed renders can't anti-alias or render progressively");
+        }
+        if(coordinatorPort > 0 && printStats) {
+            throw string("Statistics of a distributed render are printed by the workers");
+        }
+    }
+    // Each job of a server names its own image
+    if(!serveSocket.empty()) {
+        if(coordinatorPort > 0 || !workerHost.empty() || progressive) {
+            throw string("A render server can't be distributed or render progressively");
+        }
+    }
+    // Workers and servers take no output file
+    if(positional.size() < (workerHost.empty() && serveSocket.empty() ? 2u : 1u)) {
+        throw string("Missing driver or output file");
+    }
+    driverFile = positional[0];
+    if(positional.size() > 1) {
+        outputFile = positional[1];
+    }
+}
+
+int RenderOptions::threadCount() const {
+    if(numThreads > 0)
+        return numThreads;
+    int hardwareThreads = thread::hardware_concurrency();
+    return hardwareThreads > 0 ? hardwareThreads : 1;
+}
+
+string renderUsage(const string &program) {
+    return "Usage: " + program + " [--threads N] [--tile-size N] [--no-packets] [--format p3|p6|png|pfm] [--mesh-cache DIR] [--oct-normals] [--stats[=json]] [--aa-samples N] [--aa-threshold T] [--integrator recursive|wavefront] [--sort-rays] [--progressive] [--time-budget SECONDS] [--rebuild-bvh] [--coordinator PORT] driverInput imageOutput\n"
+           "       " + program + " [options] --worker HOST:PORT driverInput\n"
+           "       " + program + " [options] --serve SOCKET|- driverInput\n";
+}
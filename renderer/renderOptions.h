@@ -0,0 +1,55 @@
+#ifndef RENDER_OPTIONS_H
+#define RENDER_OPTIONS_H
+
+#include <string>
+
+class RenderOptions {
+  public:
+    std::string driverFile;
+    std::string outputFile;
+    int numThreads = 0; // 0 uses every hardware thread
+    int tileSize = 16;
+    bool usePackets = true;
+    // Output image format, picked from the output file's extension if empty
+    std::string format;
+    // Directory of built meshes reused between runs, no caching if empty
+    std::string meshCacheDirectory;
+    // Pack mesh normals into 4 bytes each
+    bool octNormals = false;
+    // Print how much memory the meshes take and what the render did
+    bool printStats = false;
+    // Print the render statistics as JSON instead of text
+    bool statsJson = false;
+    // Rays traced in pixels along edges, 1 for no anti-aliasing
+    int aaSamples = 1;
+    // Difference from a neighbouring pixel, on the 0-1 scale, that marks a pixel as an edge
+    double aaThreshold = 0.05;
+    // Render coarse to fine, rewriting the output file after every pass
+    bool progressive = false;
+    // Seconds from start up after which a progressive render stops, 0 for no limit
+    double timeBudget = 0;
+    // Trace queues of rays breadth first instead of recursing for every pixel
+    bool wavefront = false;
+    // Sort the reflection and refraction rays of the wavefront integrator for coherence
+    bool sortRays = false;
+    // Hand the tiles out to worker processes on this port instead of rendering them, 0 for none
+    int coordinatorPort = 0;
+    // Render tiles for the coordinator at workerHost:workerPort instead of writing an image
+    std::string workerHost;
+    int workerPort = 0;
+    // Keep the scene loaded and render jobs from this Unix socket, or from standard input
+    // if it is -, instead of writing one image
+    std::string serveSocket;
+    // Build the scene BVH again for every frame of an animation instead of refitting it
+    bool rebuildBVH = false;
+
+    RenderOptions() = default;
+    // Options may appear anywhere on the command line, the two positional arguments are required
+    RenderOptions(int argc, char **argv);
+
+    int threadCount() const;
+};
+
+std::string renderUsage(const std::string &program);
+
+#endif
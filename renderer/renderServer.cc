@@ -0,0 +1,118 @@
+#include "renderServer.h"
+#include "../environment/environment.h"
+#include "renderOptions.h"
+#include "parallelRenderer.h"
+#include "imageWriter.h"
+#include "framebuffer.h"
+#include "sceneEditor.h"
+#include <vector>
+#include <string>
+#include <sstream>
+#include <memory>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+
+using namespace std;
+
+bool RenderServer::serve(const function<bool(string &)> &readLine, const function<bool(const string &)> &reply) {
+    vector<string> viewLines;
+    // The first edit of the job which failed
+    string editError;
+    string line;
+    while(readLine(line)) {
+        istringstream words(line);
+        string command, outputFile;
+        words >> command;
+        if(command.empty() || command[0] == '#') continue;
+        if(command == "quit") return true;
+        if(command != "render" && command != "rerender") {
+            if(!isViewLine(command)) {
+                try {
+                    editor.processEditLine(line);
+                } catch(string s) {
+                    if(editError.empty()) editError = s;
+                }
+                continue;
+            }
+            viewLines.push_back(line);
+            continue;
+        }
+        getline(words >> ws, outputFile);
+        string result;
+        try {
+            if(!editError.empty()) throw editError;
+            if(command == "render") {
+                result = runJob(viewLines, outputFile);
+            } else {
+                result = runRerender(viewLines, outputFile);
+            }
+            jobsDone++;
+        } catch(string s) {
+            // Messages from the driver parser span several lines
+            replace(s.begin(), s.end(), '\n', ' ');
+            result = "error " + s.substr(0, s.find_last_not_of(' ') + 1);
+        }
+        viewLines.clear();
+        editError.clear();
+        if(!reply(result + "\n")) return false;
+    }
+    return false;
+}
+
+bool RenderServer::isViewLine(const string &command) {
+    return command == "eye" || command == "look" || command == "up" || command == "d" || command == "bounds"
+           || command == "res" || command == "recursionlevel";
+}
+
+string RenderServer::runRerender(const vector<string> &viewLines, const string &outputFile) {
+    if(outputFile.empty()) {
+        throw string("Missing output file after rerender");
+    }
+    if(!viewLines.empty()) {
+        throw string("A rerender keeps the view of the driver file, render changes it");
+    }
+    unique_ptr<ImageWriter> writer = imageWriterFor(outputFile, options.format);
+
+    auto renderStart = chrono::steady_clock::now();
+    editor.render(editedImage);
+    auto writeStart = chrono::steady_clock::now();
+    if(!saveImage(*writer, editedImage, outputFile)) {
+        throw string("Failed to write output file " + outputFile);
+    }
+    auto writeEnd = chrono::steady_clock::now();
+    ostringstream result;
+    result << "ok " << outputFile << " " << chrono::duration<double>(writeStart - renderStart).count()
+           << " " << chrono::duration<double>(writeEnd - writeStart).count() << " " << editor.pixelsRendered;
+    return result.str();
+}
+
+string RenderServer::runJob(const vector<string> &viewLines, const string &outputFile) {
+    if(outputFile.empty()) {
+        throw string("Missing output file after render");
+    }
+    editor.updateScene();
+    // Copying the scene copies the objects' pointers, not their meshes and BVHs
+    Environment env = scene;
+    for(const string &line: viewLines) {
+        env.processViewLine(line);
+    }
+    if(env.xRes < 1 || env.yRes < 1) {
+        throw string("Resolution must be at least 1 by 1");
+    }
+    unique_ptr<ImageWriter> writer = imageWriterFor(outputFile, options.format);
+
+    auto renderStart = chrono::steady_clock::now();
+    Framebuffer image;
+    ParallelRenderer renderer(env, options);
+    renderer.render(image, [](double) {});
+    auto writeStart = chrono::steady_clock::now();
+    if(!saveImage(*writer, image, outputFile)) {
+        throw string("Failed to write output file " + outputFile);
+    }
+    auto writeEnd = chrono::steady_clock::now();
+    ostringstream result;
+    result << "ok " << outputFile << " " << chrono::duration<double>(writeStart - renderStart).count()
+           << " " << chrono::duration<double>(writeEnd - writeStart).count();
+    return result.str();
+}
@@ -0,0 +1,55 @@
+#ifndef RENDER_SERVER_H
+#define RENDER_SERVER_H
+
+#include "../environment/environment.h"
+#include "renderOptions.h"
+#include "sceneEditor.h"
+#include "framebuffer.h"
+#include <vector>
+#include <string>
+#include <functional>
+
+// Renders jobs against a scene which stays loaded, so that a job only costs its render.
+// A job is a few driver file lines which change the view, as Environment::processViewLine
+// takes them, ended by a line naming the image to write:
+//   eye 0 1 5
+//   res 640 480
+//   render frame1.png
+// The view lines apply to that job alone, every job starts from the view of the driver
+// file. Lines which SceneEditor::processEditLine takes edit the scene for every later job,
+// and a job ended by
+//   rerender OUTPUT
+// renders only the pixels the edits since the last rerender may have changed, with one
+// ray each and the view of the driver file. Each job gets a one line reply, either
+//   ok OUTPUT RENDER_SECONDS WRITE_SECONDS
+// with the pixels rendered after it for a rerender, or error followed by what went wrong,
+// which for an edit is sent at the end of its job. A line saying quit stops the server.
+class RenderServer {
+  public:
+    // options apply to every job, picking the threads, integrator and image format. Edits
+    // change scene in place.
+    RenderServer(Environment &scene, const RenderOptions &options): scene(scene), options(options),
+                                                                    editor(scene, options) {}
+
+    // Runs jobs read with readLine, which returns false once there are no more, and sends
+    // each reply with reply. Returns true if it stopped at a quit line.
+    bool serve(const std::function<bool(std::string &)> &readLine,
+               const std::function<bool(const std::string &)> &reply);
+
+    long jobsDone = 0;
+
+  private:
+    // Whether lines starting with command change the view of a job
+    static bool isViewLine(const std::string &command);
+    // Return the reply, throwing a string if the job failed
+    std::string runJob(const std::vector<std::string> &viewLines, const std::string &outputFile);
+    std::string runRerender(const std::vector<std::string> &viewLines, const std::string &outputFile);
+
+    Environment &scene;
+    const RenderOptions &options;
+    SceneEditor editor;
+    // Kept between rerenders, which only render the pixels which changed
+    Framebuffer editedImage;
+};
+
+#endif
@@ -0,0 +1,303 @@
+#include "sceneEditor.h"
+#include "../environment/environment.h"
+#include "../sceneObjects/sphere.h"
+#include "../sceneObjects/model.h"
+#include "../sceneObjects/transformation.h"
+#include "../dataStructures/material.h"
+#include "parallelRenderer.h"
+#include "framebuffer.h"
+#include <Eigen/Dense>
+#include <vector>
+#include <memory>
+#include <string>
+#include <sstream>
+#include <algorithm>
+#include <functional>
+
+using namespace std;
+using namespace Eigen;
+
+SceneEditor::SceneEditor(Environment &env, const RenderOptions &options): env(env), renderer(env, options) {
+    for(const auto &object: env.sceneObjects) {
+        objectBounds.push_back(object->getBounds());
+    }
+    mapBVH();
+}
+
+Sphere &SceneEditor::sphereAt(int object) {
+    Sphere *sphere = object >= 0 && object < int(env.sceneObjects.size())
+                     ? dynamic_cast<Sphere *>(env.sceneObjects[object].get()) : nullptr;
+    if(!sphere) {
+        throw string("Object " + to_string(object) + " isn't a sphere");
+    }
+    return *sphere;
+}
+
+Model &SceneEditor::modelAt(int object) {
+    Model *model = object >= 0 && object < int(env.sceneObjects.size())
+                   ? dynamic_cast<Model *>(env.sceneObjects[object].get()) : nullptr;
+    if(!model) {
+        throw string("Object " + to_string(object) + " isn't a model");
+    }
+    return *model;
+}
+
+int SceneEditor::addSphere(const Sphere &sphere) {
+    env.sceneObjects.emplace_back(new Sphere(sphere));
+    objectsChanged = true;
+    return env.sceneObjects.size() - 1;
+}
+
+void SceneEditor::removeObject(int object) {
+    if(object < 0 || object >= int(env.sceneObjects.size())) {
+        throw string("There is no object " + to_string(object));
+    }
+    env.sceneObjects.erase(env.sceneObjects.begin() + object);
+    objectsChanged = true;
+}
+
+void SceneEditor::moveSphere(int object, const Vector3d &center, double radius) {
+    Sphere &sphere = sphereAt(object);
+    sphere.center = center;
+    sphere.radius = radius;
+    objectMoved(object);
+}
+
+void SceneEditor::setSphereMaterial(int object, const Material &material) {
+    Sphere &sphere = sphereAt(object);
+    sphere.material = material;
+    objectReshaded(sphere);
+}
+
+void SceneEditor::moveModel(int object, const Matrix4r &motion) {
+    modelAt(object).place(motion);
+    objectMoved(object);
+}
+
+void SceneEditor::setModelMaterial(int object, int material, const Material &newMaterial) {
+    Model &model = modelAt(object);
+    model.setMaterial(material, newMaterial);
+    objectReshaded(model);
+}
+
+int SceneEditor::addLight(const Light &light) {
+    env.lightSources.push_back(light);
+    lightsChanged = lightTreeChanged = true;
+    return env.lightSources.size() - 1;
+}
+
+void SceneEditor::setLight(int light, const Light &newLight) {
+    if(light < 0 || light >= int(env.lightSources.size())) {
+        throw string("There is no light " + to_string(light));
+    }
+    env.lightSources[light] = newLight;
+    lightsChanged = lightTreeChanged = true;
+}
+
+void SceneEditor::removeLight(int light) {
+    if(light < 0 || light >= int(env.lightSources.size())) {
+        throw string("There is no light " + to_string(light));
+    }
+    env.lightSources.erase(env.lightSources.begin() + light);
+    lightsChanged = lightTreeChanged = true;
+}
+
+void SceneEditor::processEditLine(const string &line) {
+    istringstream words(line);
+    string command;
+    words >> command;
+    if(command.empty() || command[0] == '#') return;
+    if(command == "sphere" || command == "model" || command == "light") {
+        env.processAddLine(line);
+        if(command == "light") {
+            lightsChanged = lightTreeChanged = true;
+        } else {
+            objectsChanged = true;
+        }
+        return;
+    }
+    const string malformed = "Malformed edit line: " + line;
+    auto number = [&]() {
+        double value;
+        if(!(words >> value)) throw malformed;
+        return value;
+    };
+    auto index = [&]() {
+        int value;
+        if(!(words >> value)) throw malformed;
+        return value;
+    };
+    auto lineEnd = [&]() {
+        string extra;
+        if(words >> extra) throw malformed;
+    };
+    // Everything after the words read so far
+    auto statement = [&]() {
+        string rest;
+        getline(words >> ws, rest);
+        return rest;
+    };
+
+    if(command == "remove") {
+        int object = index();
+        lineEnd();
+        removeObject(object);
+    } else if(command == "movesphere") {
+        int object = index();
+        Vector3d center;
+        center(0) = number();
+        center(1) = number();
+        center(2) = number();
+        double radius = number();
+        lineEnd();
+        moveSphere(object, center, radius);
+    } else if(command == "movemodel") {
+        int object = index();
+        double values[8];
+        for(double &value: values) {
+            value = number();
+        }
+        lineEnd();
+        Transformation motion(values[0], values[1], values[2], values[3], values[4], values[5], values[6], values[7]);
+        moveModel(object, motion.getTransformationMatrix());
+    } else if(command == "spherematerial") {
+        int object = index();
+        Material material = sphereAt(object).material;
+        if(!applyMaterialStatement(material, statement())) throw malformed;
+        setSphereMaterial(object, material);
+    } else if(command == "modelmaterial") {
+        int object = index();
+        string name;
+        if(!(words >> name)) throw malformed;
+        const vector<Material> &materials = modelAt(object).getMaterials();
+        int found = 0;
+        while(found < int(materials.size()) && materials[found].name != name) found++;
+        if(found == int(materials.size())) {
+            throw string("Object " + to_string(object) + " has no material " + name);
+        }
+        Material material = materials[found];
+        if(!applyMaterialStatement(material, statement())) throw malformed;
+        setModelMaterial(object, found, material);
+    } else if(command == "setlight") {
+        int light = index();
+        Light newLight;
+        for(int axis = 0; axis < 3; axis++) {
+            newLight.pos(axis) = number();
+        }
+        newLight.atInfinity = number() == 0.0;
+        for(int channel = 0; channel < 3; channel++) {
+            newLight.color(channel) = number();
+        }
+        lineEnd();
+        setLight(light, newLight);
+    } else if(command == "removelight") {
+        int light = index();
+        lineEnd();
+        removeLight(light);
+    } else {
+        throw string("Unknown edit " + command);
+    }
+}
+
+void SceneEditor::objectReshaded(const SceneObject &object) {
+    // Shadows filtered by the transparency of what they cross may fall anywhere
+    if(env.transparentShadows) {
+        renderAll = true;
+    }
+    reshadedObjects.push_back(&object);
+}
+
+void SceneEditor::objectMoved(int object) {
+    movedObjects.push_back(object);
+    renderAll = true;
+}
+
+void SceneEditor::rebuildBVH() {
+    objectBounds.clear();
+    for(const auto &object: env.sceneObjects) {
+        objectBounds.push_back(object->getBounds());
+    }
+    env.numBVHNodes -= env.sceneBVH.nodes.size();
+    env.sceneBVH.build(objectBounds);
+    env.numBVHNodes += env.sceneBVH.nodes.size();
+    mapBVH();
+}
+
+void SceneEditor::mapBVH() {
+    const BVH &bvh = env.sceneBVH;
+    parents.assign(bvh.nodes.size(), -1);
+    objectLeaves.assign(env.sceneObjects.size(), -1);
+    for(size_t current = 0; current < bvh.nodes.size(); current++) {
+        const BVHNode &node = bvh.nodes[current];
+        if(node.isLeaf()) {
+            for(int i = node.firstPrimitive; i < node.firstPrimitive + node.primitiveCount; i++) {
+                objectLeaves[bvh.primitiveIndices[i]] = current;
+            }
+        } else {
+            parents[current + 1] = current;
+            parents[node.rightChild] = current;
+        }
+    }
+}
+
+void SceneEditor::updateScene() {
+    if(objectsChanged) {
+        rebuildBVH();
+        bvhRebuilt = true;
+        renderAll = true;
+    } else if(!movedObjects.empty()) {
+        // The leaves holding the moved objects and everything above them, children first
+        vector<char> refit(env.sceneBVH.nodes.size(), 0);
+        vector<int> nodes;
+        for(int object: movedObjects) {
+            objectBounds[object] = env.sceneObjects[object]->getBounds();
+            for(int node = objectLeaves[object]; node >= 0 && !refit[node]; node = parents[node]) {
+                refit[node] = 1;
+                nodes.push_back(node);
+            }
+        }
+        sort(nodes.begin(), nodes.end(), greater<int>());
+        env.sceneBVH.refitNodes(objectBounds, nodes);
+        bvhNodesRefit += nodes.size();
+    }
+    if(lightTreeChanged) {
+        env.lightTree.build(env.lightSources);
+    }
+    objectsChanged = false;
+    movedObjects.clear();
+    lightTreeChanged = false;
+}
+
+void SceneEditor::render(Framebuffer &image) {
+    updateScene();
+    if(image.width != env.xRes || image.height != env.yRes) {
+        image = Framebuffer(env.xRes, env.yRes);
+        renderAll = true;
+    }
+
+    vector<char> pixels(env.xRes*env.yRes, renderAll);
+    if(!renderAll) {
+        sort(reshadedObjects.begin(), reshadedObjects.end());
+        for(size_t pixel = 0; pixel < pixels.size(); pixel++) {
+            if(lightsChanged) {
+                pixels[pixel] = !objectsHit.empty(pixel);
+                continue;
+            }
+            for(auto object = objectsHit.begin(pixel); object != objectsHit.end(pixel); object++) {
+                if(binary_search(reshadedObjects.begin(), reshadedObjects.end(), *object)) {
+                    pixels[pixel] = 1;
+                    break;
+                }
+            }
+        }
+    }
+    pixelsRendered = count(pixels.begin(), pixels.end(), 1);
+    renderer.renderPixels(image, pixels, objectsHit);
+
+    renderAll = false;
+    lightsChanged = false;
+    reshadedObjects.clear();
+    // Counted from one render to the next
+    bvhRebuilt = false;
+    bvhNodesRefit = 0;
+}
@@ -0,0 +1,99 @@
+#ifndef SCENE_EDITOR_H
+#define SCENE_EDITOR_H
+
+#include "../environment/environment.h"
+#include "../sceneObjects/sphere.h"
+#include "../sceneObjects/model.h"
+#include "../dataStructures/light.h"
+#include "../dataStructures/material.h"
+#include "../dataStructures/boundingBox.h"
+#include "parallelRenderer.h"
+#include "renderOptions.h"
+#include "framebuffer.h"
+#include <Eigen/Dense>
+#include <vector>
+#include <string>
+
+// Edits a loaded scene in place for interactive tools, and renders only what the edits
+// since the last render could have changed. Every pixel remembers the objects its rays
+// hit, so a new material is only rendered where the object was seen, directly or through
+// reflections and refraction, and a changed light wherever anything was hit. Moving an
+// object refits only the nodes of the scene BVH above it, and adding or removing one
+// builds the scene BVH again; both render the whole image, since the object's shadows and
+// reflections may fall anywhere.
+//
+// Objects and lights are indices into env.sceneObjects and env.lightSources, and
+// removing one moves the later ones down. Edits throw a string for an index which
+// doesn't name an object of the right kind. Copies of the environment share its objects,
+// so they see the edits too.
+//
+// processEditLine takes the same edits as lines of text, for --serve:
+//   sphere, model or light lines as in the driver file, adding an object or light
+//   remove OBJECT
+//   movesphere OBJECT X Y Z RADIUS
+//   movemodel OBJECT WX WY WZ THETA SCALE TX TY TZ, moving it as an objectkey line would
+//   spherematerial OBJECT STATEMENT, such as spherematerial 5 Kd 0.9 0.1 0.1
+//   modelmaterial OBJECT MATERIAL STATEMENT, for the model's material of that name
+//   setlight LIGHT X Y Z W R G B, as a light line
+//   removelight LIGHT
+// where a statement is any line of a material file changing a value.
+class SceneEditor {
+  public:
+    // options pick the threads and tile size; pixels are rendered with one ray each
+    SceneEditor(Environment &env, const RenderOptions &options);
+
+    int addSphere(const Sphere &sphere);
+    void removeObject(int object);
+    void moveSphere(int object, const Eigen::Vector3d &center, double radius);
+    void setSphereMaterial(int object, const Material &material);
+    // Moves a model by motion from where its driver file line placed it
+    void moveModel(int object, const Matrix4r &motion);
+    // Changes one of the materials of a model, as Model::setMaterial does
+    void setModelMaterial(int object, int material, const Material &newMaterial);
+    int addLight(const Light &light);
+    void setLight(int light, const Light &newLight);
+    void removeLight(int light);
+    // Throws a string if the line isn't a valid edit
+    void processEditLine(const std::string &line);
+
+    // Brings the scene BVH and light tree up to date with the edits, which render does
+    // first, so the environment can be rendered some other way
+    void updateScene();
+    // Renders the pixels the edits since the last call may have changed into image, which
+    // must be kept between calls. The first call, and any after the resolution changed,
+    // render every pixel.
+    void render(Framebuffer &image);
+
+    // What the last render did
+    long pixelsRendered = 0;
+    int bvhNodesRefit = 0;
+    bool bvhRebuilt = false;
+
+  private:
+    Sphere &sphereAt(int object);
+    Model &modelAt(int object);
+    void objectReshaded(const SceneObject &object);
+    void objectMoved(int object);
+    void rebuildBVH();
+    void mapBVH();
+
+    Environment &env;
+    ParallelRenderer renderer;
+    // Objects hit by the rays of every pixel
+    PixelObjects objectsHit;
+    // The scene BVH's parent of every node and leaf holding every object
+    std::vector<int> parents;
+    std::vector<int> objectLeaves;
+    std::vector<BoundingBox> objectBounds;
+
+    // Edits the scene hasn't been updated for
+    bool objectsChanged = false;
+    std::vector<int> movedObjects;
+    bool lightTreeChanged = false;
+    // Edits since the last render
+    bool renderAll = true;
+    bool lightsChanged = false;
+    std::vector<const SceneObject *> reshadedObjects;
+};
+
+#endif
@@ -0,0 +1,219 @@
+#include "shading.h"
+#include "../environment/environment.h"
+#include "../dataStructures/light.h"
+#include "../sceneObjects/sphere.h"
+#include "../dataStructures/ray.h"
+#include "../dataStructures/rayPacket.h"
+#include <Eigen/Dense>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace Eigen;
+
+void intersectPixel(Ray &ray, const Environment &env) {
+    env.intersectRay(ray);
+}
+
+// With transparent shadows, every surface crossed on the way filters the light, otherwise
+// any surface blocks it
+Vector3r getShadowCoeff(const Ray &ray, RenderContext &context, int light) {
+    const Environment &env = context.env;
+    context.counters.shadowRays++;
+    Vector3r shadowCoeff = Vector3r(1.0, 1.0, 1.0);
+    if(!env.transparentShadows) {
+        Occluder &last = context.lastOccluders[light];
+        if(last.object) {
+            context.counters.occluderCacheLookups++;
+            if(last.object->primitiveOccludes(ray, last.primitive)) {
+                context.counters.occluderCacheHits++;
+                context.counters.blockedShadowRays++;
+                return Vector3r(0,0,0);
+            }
+        }
+        // Forgotten if nothing blocks this ray, so lit surfaces don't pay for the test
+        last.object = nullptr;
+        env.forEachObjectAlong(ray, [&](const SceneObject &obj) {
+            int primitive;
+            if(!obj.occludes(ray, primitive)) return false;
+            last.object = &obj;
+            last.primitive = primitive;
+            context.counters.blockedShadowRays++;
+            shadowCoeff = Vector3r(0,0,0);
+            return true;
+        });
+        return shadowCoeff;
+    }
+    env.forEachObjectAlong(ray, [&](const SceneObject &obj) {
+        return obj.attenuate(ray, shadowCoeff);
+    });
+    return shadowCoeff;
+}
+
+Vector3r pixelToColorVector(Ray &ray, RenderContext &context, int recursionLevel) {
+    intersectPixel(ray, context.env);
+    return shadeIntersection(ray, context, recursionLevel);
+}
+
+bool shadowRayToLight(const Ray &ray, const Light &light, Ray &toLight, Real &intersectCosine) {
+    Vector3r dirToLight = light.pos - ray.intersect;
+    dirToLight = dirToLight / dirToLight.norm();
+    intersectCosine = dirToLight.dot(ray.surfaceNormal);
+    if(!(intersectCosine > 0)) return false;
+    toLight.origin = ray.intersect+dirToLight*0.00000001;
+    toLight.dir = dirToLight;
+    toLight.foundIntersect = true;
+    toLight.distanceToIntersect = (light.pos - toLight.origin).norm();
+    return true;
+}
+
+void addLitColor(const Ray &ray, const Material &mat, const Light &light, const Vector3r &dirToLight,
+                 Real intersectCosine, const Vector3r &shadowCoeff, Vector3r &color) {
+    color += (mat.diffuse.cwiseProduct(light.color) * intersectCosine).cwiseProduct(shadowCoeff);
+    Vector3r interToRay = (ray.origin - ray.intersect);
+    interToRay = interToRay / interToRay.norm();
+    Vector3r reflectionRay = 2*intersectCosine*ray.surfaceNormal - dirToLight;
+    reflectionRay = reflectionRay / reflectionRay.norm();
+    Real reflectCosine = reflectionRay.dot(interToRay);
+    if(reflectCosine > 0) {
+        color += (mat.specular.cwiseProduct(light.color)*pow(reflectCosine, mat.specularExponent)).cwiseProduct(shadowCoeff);
+    }
+}
+
+// Adds the diffuse and specular light from a light, scaled by weight, to color. lightIndex
+// is the light in lightSources the light stands for.
+void addLight(const Ray &ray, const Material &mat, const Light &light, int lightIndex, Real weight,
+              RenderContext &context, Vector3r &color) {
+    Ray toLight;
+    Real intersectCosine;
+    if(!shadowRayToLight(ray, light, toLight, intersectCosine)) {
+        context.counters.culledShadowRays++;
+        return;
+    }
+    Vector3r shadowCoeff = getShadowCoeff(toLight, context, lightIndex) * weight;
+    if(shadowCoeff != Vector3r(0,0,0)) {
+        addLitColor(ray, mat, light, toLight.dir, intersectCosine, shadowCoeff, color);
+    }
+}
+
+void countShadedRay(RenderContext &context, int recursionLevel) {
+    int depth = context.env.recursionLevel - recursionLevel;
+    context.counters.raysAtDepth[min(depth, RENDER_DEPTH_BUCKETS - 1)]++;
+    if(depth == 0) {
+        context.counters.primaryRays++;
+    }
+}
+
+bool reflectionRay(const Ray &ray, Ray &reflect) {
+    if(ray.material->illuminationModel < 3) return false;
+    Vector3r reflectionDir = -ray.dir;
+    if(reflectionDir.dot(ray.surfaceNormal) < 0.1 && !dynamic_cast<const Sphere *>(ray.intersectObject)) {
+        return false;
+    }
+    reflectionDir = 2*reflectionDir.dot(ray.surfaceNormal)*ray.surfaceNormal - reflectionDir;
+    reflectionDir = reflectionDir / reflectionDir.norm();
+    reflect.dir = reflectionDir;
+    reflect.origin = ray.intersect;
+    return true;
+}
+
+bool refractionRay(Ray &ray, Ray &refract) {
+    const Material &mat = *ray.material;
+    if(mat.illuminationModel < 6 || mat.refractiveIndex <= 0.0001 || !ray.intersectObject) return false;
+    try {
+        refract = ray.intersectObject->getRefractionRay(ray);
+        return true;
+    } catch (string s) {
+        return false;
+    }
+}
+
+Vector3r shadeIntersection(Ray &ray, RenderContext &context, int recursionLevel) {
+    countShadedRay(context, recursionLevel);
+    if(!ray.foundIntersect) {
+        return Vector3r(0,0,0);
+    }
+    if(context.objectsHit) {
+        context.objectsHit->push_back(ray.intersectObject);
+    }
+    const Environment &env = context.env;
+    const Material &mat = *ray.material;
+    Vector3r color = env.amb.cwiseProduct(mat.ambient);
+    forEachShadingLight(ray, context, [&](const Light &light, int lightIndex, Real weight) {
+        addLight(ray, mat, light, lightIndex, weight, context, color);
+    });
+    Ray reflect;
+    if(recursionLevel > 0 && reflectionRay(ray, reflect)) {
+        context.counters.reflectionRays++;
+        color += mat.reflective.cwiseProduct(pixelToColorVector(reflect, context, recursionLevel-1));
+    }
+    Ray refractRay;
+    if(recursionLevel > 0 && refractionRay(ray, refractRay)) {
+        context.counters.refractionRays++;
+        color += mat.transparency.cwiseProduct(pixelToColorVector(refractRay, context, recursionLevel-1));
+    }
+    return color;
+}
+
+Ray primaryRay(Real x, Real y, const Environment &env) {
+    Real distX = ((x/(env.xRes-1.0))*(env.maxHor - env.minHor)) + env.minHor;
+    Real distY = ((y/(env.yRes-1.0))*(env.minVer - env.maxVer)) + env.maxVer;
+    Ray ray;
+    ray.origin = env.eye + (-env.focalLength)*env.wCam + distX*env.uCam + distY*env.vCam;
+    ray.dir = ray.origin - env.eye;
+    ray.dir = ray.dir / ray.dir.norm();
+    return ray;
+}
+
+Vector3r pixelToColor(long x, long y, RenderContext &context) {
+    context.beginPixel(x, y);
+    Ray ray = primaryRay(x, y, context.env);
+    return pixelToColorVector(ray, context, context.env.recursionLevel);
+}
+
+void pixelSamplePoints(long x, long y, int samples, Random &random, vector<Vector2r> &points) {
+    vector<int> rows(samples);
+    for(int i = 0; i < samples; i++) {
+        rows[i] = i;
+    }
+    for(int i = samples - 1; i > 0; i--) {
+        swap(rows[i], rows[random.next() % (i + 1)]);
+    }
+    points.clear();
+    for(int column = 0; column < samples; column++) {
+        Real offsetX = (column + random.uniform()) / samples - Real(0.5);
+        Real offsetY = (rows[column] + random.uniform()) / samples - Real(0.5);
+        points.emplace_back(x + offsetX, y + offsetY);
+    }
+}
+
+Vector3r supersamplePixel(long x, long y, int samples, RenderContext &context) {
+    context.beginPixel(x, y);
+    vector<Vector2r> points;
+    pixelSamplePoints(x, y, samples, context.random, points);
+    Vector3r color(0,0,0);
+    for(const Vector2r &point: points) {
+        Ray ray = primaryRay(point(0), point(1), context.env);
+        color += pixelToColorVector(ray, context, context.env.recursionLevel);
+    }
+    return color / samples;
+}
+
+void pixelPacketToColors(long x, long y, int count, RenderContext &context, Vector3r *colors) {
+    const Environment &env = context.env;
+    Ray rays[SIMD_WIDTH];
+    RayPacket packet;
+    for(int lane = 0; lane < count; lane++) {
+        rays[lane] = primaryRay(x + lane, y, env);
+        packet.setRay(lane, rays[lane].origin, rays[lane].dir);
+    }
+    env.intersectPacket(packet);
+    // Secondary rays go their own ways, so everything after the primary hit is traced one ray at a time
+    for(int lane = 0; lane < count; lane++) {
+        env.resolvePacketHit(packet, lane, rays[lane]);
+        context.beginPixel(x + lane, y);
+        colors[lane] = shadeIntersection(rays[lane], context, env.recursionLevel);
+    }
+}
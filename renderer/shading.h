@@ -0,0 +1,67 @@
+#ifndef SHADING_H
+#define SHADING_H
+
+#include "../environment/environment.h"
+#include "renderContext.h"
+#include "../dataStructures/ray.h"
+#include <Eigen/Dense>
+#include <string>
+#include <vector>
+
+void intersectPixel(Ray &ray, const Environment &env);
+// Fraction of the light from lightSources[light] which reaches the end of the ray
+Vector3r getShadowCoeff(const Ray &ray, RenderContext &context, int light);
+Vector3r pixelToColorVector(Ray &ray, RenderContext &context, int recursionLevel);
+// Shadow ray from a hit towards a light, false if the light is behind the surface
+bool shadowRayToLight(const Ray &ray, const Light &light, Ray &toLight, Real &intersectCosine);
+// Adds the diffuse and specular light from a light reaching a hit, scaled by shadowCoeff
+void addLitColor(const Ray &ray, const Material &mat, const Light &light, const Vector3r &dirToLight,
+                 Real intersectCosine, const Vector3r &shadowCoeff, Vector3r &color);
+// Counts a ray reaching shading at the given recursion level
+void countShadedRay(RenderContext &context, int recursionLevel);
+// The reflection and refraction rays a hit spawns, false if its material doesn't
+bool reflectionRay(const Ray &ray, Ray &reflect);
+bool refractionRay(Ray &ray, Ray &refract);
+// Calls visit(light, lightIndex, weight) for the lights which shade a hit, as picked by
+// the scene's light sampling. lightIndex is the light in lightSources the light stands for.
+template<typename Visitor>
+void forEachShadingLight(const Ray &ray, RenderContext &context, Visitor visit);
+// Colour of a ray whose closest hit has already been found
+Vector3r shadeIntersection(Ray &ray, RenderContext &context, int recursionLevel);
+Ray primaryRay(Real x, Real y, const Environment &env);
+Vector3r pixelToColor(long x, long y, RenderContext &context);
+// Averages samples rays spread over the pixel, which extends half a pixel around (x, y).
+// The pixel is split into samples columns and samples rows, and each column and each row
+// gets one ray at a random point of a cell.
+Vector3r supersamplePixel(long x, long y, int samples, RenderContext &context);
+// The points supersamplePixel traces through
+void pixelSamplePoints(long x, long y, int samples, Random &random, std::vector<Vector2r> &points);
+// Colours count (at most SIMD_WIDTH) pixels of row y starting at column x, tracing their
+// primary rays as one packet
+void pixelPacketToColors(long x, long y, int count, RenderContext &context, Vector3r *colors);
+
+template<typename Visitor>
+void forEachShadingLight(const Ray &ray, RenderContext &context, Visitor visit) {
+    const Environment &env = context.env;
+    if(env.lightSampling == LightSampling::Exact) {
+        for(size_t light = 0; light < env.lightSources.size(); light++) {
+            visit(env.lightSources[light], light, 1);
+        }
+    } else if(env.lightSampling == LightSampling::Sampled) {
+        // Each sample stands for all the lights, weighted by how likely it was to be picked
+        for(int sample = 0; sample < env.lightSamples; sample++) {
+            int light;
+            Real probability;
+            if(env.lightTree.sample(ray.intersect, ray.surfaceNormal, context.random, light, probability)) {
+                visit(env.lightSources[light], light, 1 / (probability*env.lightSamples));
+            }
+        }
+    } else {
+        env.lightTree.forEachCluster(ray.intersect, ray.surfaceNormal, env.clusterThreshold, context.random,
+                                     [&](const Light &cluster, int light) {
+            visit(cluster, light, 1);
+        });
+    }
+}
+
+#endif
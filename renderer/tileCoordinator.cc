@@ -0,0 +1,227 @@
+#include "tileCoordinator.h"
+#include "../environment/environment.h"
+#include "../dataStructures/connection.h"
+#include "tileScheduler.h"
+#include "framebuffer.h"
+#include "parallelRenderer.h"
+#include <Eigen/Dense>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <string>
+#include <cstring>
+#include <cstdint>
+
+using namespace std;
+using namespace Eigen;
+
+// Seconds a worker keeps trying to reach its coordinator
+#define WORKER_CONNECT_SECONDS 60
+// Seconds after which either side gives up on the other if its machine stops answering
+#define TILE_PEER_DEAD_SECONDS 30
+
+TileCoordinator::TileCoordinator(int port, long width, long height, int tileSize)
+    : listener(port), width(width), height(height), tiles(splitIntoTiles(width, height, tileSize)) {}
+
+void TileCoordinator::render(Framebuffer &image, const function<void(double)> &progress) {
+    image = Framebuffer(width, height);
+    pending.clear();
+    for(size_t i = 0; i < tiles.size(); i++) {
+        pending.push_back(i);
+    }
+    finished.assign(tiles.size(), 0);
+    tilesFinished = 0;
+    workersConnected = 0;
+    tilesRedispatched = 0;
+
+    vector<unique_ptr<Connection>> connections;
+    vector<thread> threads;
+    while(true) {
+        Connection connection = listener.accept(250);
+        {
+            lock_guard<mutex> guard(lock);
+            if(tilesFinished == tiles.size()) break;
+        }
+        if(connection.isOpen()) {
+            // A worker whose machine goes down never closes its connection, and would
+            // keep its tiles forever
+            connection.detectDeadPeer(TILE_PEER_DEAD_SECONDS);
+            connections.emplace_back(new Connection(move(connection)));
+            threads.emplace_back(&TileCoordinator::serveWorker, this, ref(*connections.back()), ref(image));
+        }
+        lock_guard<mutex> guard(lock);
+        progress(double(tilesFinished) / tiles.size());
+    }
+    // Workers still rendering tiles that were finished elsewhere aren't waited for
+    for(auto &connection: connections) {
+        connection->shutdown();
+    }
+    for(thread &thread: threads) {
+        thread.join();
+    }
+}
+
+void TileCoordinator::serveWorker(Connection &connection, Framebuffer &image) {
+    uint32_t hello[4];
+    if(!connection.readUint32s(hello, 4)) return;
+    uint32_t size[2] = {uint32_t(width), uint32_t(height)};
+    if(hello[0] != TILE_PROTOCOL_MAGIC || hello[1] != TILE_PROTOCOL_VERSION || !connection.writeUint32s(size, 2)
+       || hello[2] != size[0] || hello[3] != size[1]) {
+        return;
+    }
+    {
+        lock_guard<mutex> guard(lock);
+        workersConnected++;
+    }
+
+    // Tiles sent to this worker which haven't come back
+    vector<int> assigned;
+    uint32_t message, value;
+    while(connection.readUint32(message)) {
+        if(message == TILE_MESSAGE_REQUEST) {
+            if(!connection.readUint32(value) || !sendTiles(connection, value, assigned)) break;
+        } else if(message != TILE_MESSAGE_RESULT || !receiveTile(connection, assigned, image)) {
+            break;
+        }
+    }
+
+    lock_guard<mutex> guard(lock);
+    for(int index: assigned) {
+        if(!finished[index]) {
+            pending.push_front(index);
+            tilesRedispatched++;
+        }
+    }
+    changed.notify_all();
+}
+
+bool TileCoordinator::sendTiles(Connection &connection, uint32_t count, vector<int> &assigned) {
+    vector<uint32_t> reply(1, 0);
+    {
+        unique_lock<mutex> guard(lock);
+        // Tiles handed out again may have been finished by their first worker meanwhile
+        while(reply[0] == 0 && tilesFinished < tiles.size()) {
+            changed.wait(guard, [&]() { return !pending.empty() || tilesFinished == tiles.size(); });
+            while(reply[0] < max<uint32_t>(count, 1) && !pending.empty()) {
+                int index = pending.front();
+                pending.pop_front();
+                if(finished[index]) continue;
+                const Tile &tile = tiles[index];
+                uint32_t values[5] = {uint32_t(index), uint32_t(tile.x0), uint32_t(tile.y0), uint32_t(tile.x1), uint32_t(tile.y1)};
+                reply.insert(reply.end(), values, values + 5);
+                assigned.push_back(index);
+                reply[0]++;
+            }
+        }
+    }
+    return connection.writeUint32s(reply.data(), reply.size());
+}
+
+bool TileCoordinator::receiveTile(Connection &connection, vector<int> &assigned, Framebuffer &image) {
+    uint32_t index;
+    if(!connection.readUint32(index)) return false;
+    auto held = find(assigned.begin(), assigned.end(), int(index));
+    if(held == assigned.end()) return false;
+    const Tile &tile = tiles[index];
+    long tileWidth = tile.x1 - tile.x0;
+    vector<uint32_t> bits(3*tileWidth*(tile.y1 - tile.y0));
+    if(!connection.readUint32s(bits.data(), bits.size())) return false;
+    assigned.erase(held);
+
+    lock_guard<mutex> guard(lock);
+    // A tile handed out again may come back twice, with the same pixels
+    if(finished[index]) return true;
+    for(long y = tile.y0; y < tile.y1; y++) {
+        for(long x = tile.x0; x < tile.x1; x++) {
+            float color[3];
+            memcpy(color, &bits[3*((y - tile.y0)*tileWidth + x - tile.x0)], sizeof(color));
+            image.setPixel(x, y, Vector3r(color[0], color[1], color[2]));
+        }
+    }
+    finished[index] = 1;
+    if(++tilesFinished == tiles.size()) {
+        changed.notify_all();
+    }
+    return true;
+}
+
+Connection connectToCoordinator(const string &host, int port) {
+    auto giveUp = chrono::steady_clock::now() + chrono::seconds(WORKER_CONNECT_SECONDS);
+    while(true) {
+        try {
+            return connectTcp(host, port);
+        } catch(string s) {
+            if(chrono::steady_clock::now() >= giveUp) throw;
+        }
+        this_thread::sleep_for(chrono::milliseconds(250));
+    }
+}
+
+long renderForCoordinator(const string &host, int port, const Environment &env, ParallelRenderer &renderer,
+                          int batchSize) {
+    Connection connection = connectToCoordinator(host, port);
+    connection.detectDeadPeer(TILE_PEER_DEAD_SECONDS);
+    const string lost = "Lost the connection to the coordinator at " + host + ":" + to_string(port);
+    uint32_t hello[4] = {TILE_PROTOCOL_MAGIC, TILE_PROTOCOL_VERSION, uint32_t(env.xRes), uint32_t(env.yRes)};
+    uint32_t size[2];
+    if(!connection.writeUint32s(hello, 4) || !connection.readUint32s(size, 2)) {
+        throw lost;
+    }
+    if(size[0] != env.xRes || size[1] != env.yRes) {
+        throw string("The coordinator renders " + to_string(size[0]) + " by " + to_string(size[1])
+                     + " pixels, but this scene is " + to_string(env.xRes) + " by " + to_string(env.yRes));
+    }
+
+    long tilesRendered = 0;
+    while(true) {
+        uint32_t request[2] = {TILE_MESSAGE_REQUEST, uint32_t(batchSize)};
+        uint32_t count;
+        if(!connection.writeUint32s(request, 2) || !connection.readUint32(count)) {
+            throw lost;
+        }
+        if(count == 0) break;
+        vector<uint32_t> values(5*count);
+        if(!connection.readUint32s(values.data(), values.size())) {
+            throw lost;
+        }
+        vector<Tile> tiles(count);
+        vector<uint32_t> indices(count);
+        for(uint32_t i = 0; i < count; i++) {
+            indices[i] = values[5*i];
+            Tile &tile = tiles[i];
+            tile.x0 = values[5*i + 1];
+            tile.y0 = values[5*i + 2];
+            tile.x1 = values[5*i + 3];
+            tile.y1 = values[5*i + 4];
+            if(tile.x0 >= tile.x1 || tile.y0 >= tile.y1 || tile.x1 > env.xRes || tile.y1 > env.yRes) {
+                throw string("The coordinator sent a tile outside the image");
+            }
+        }
+
+        // Tiles are sent back as soon as they are done, by the thread which rendered them
+        mutex sendLock;
+        bool sendFailed = false;
+        renderer.renderTiles(tiles, [&](const Tile &tile, const Framebuffer &tileImage) {
+            size_t i = 0;
+            while(tiles[i].x0 != tile.x0 || tiles[i].y0 != tile.y0) i++;
+            long tileWidth = tile.x1 - tile.x0;
+            vector<uint32_t> message(2 + 3*tileWidth*(tile.y1 - tile.y0));
+            message[0] = TILE_MESSAGE_RESULT;
+            message[1] = indices[i];
+            memcpy(&message[2], tileImage.row(0), 3*tileWidth*(tile.y1 - tile.y0)*sizeof(float));
+            lock_guard<mutex> guard(sendLock);
+            sendFailed = sendFailed || !connection.writeUint32s(message.data(), message.size());
+        });
+        if(sendFailed) {
+            throw lost;
+        }
+        tilesRendered += count;
+    }
+    return tilesRendered;
+}
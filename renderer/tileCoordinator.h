@@ -0,0 +1,79 @@
+#ifndef TILE_COORDINATOR_H
+#define TILE_COORDINATOR_H
+
+#include "../environment/environment.h"
+#include "../dataStructures/connection.h"
+#include "tileScheduler.h"
+#include "framebuffer.h"
+#include "parallelRenderer.h"
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <string>
+#include <cstdint>
+
+// Tiles are rendered by worker processes which each load the scene themselves, connect to
+// the coordinator over TCP and ask it for a batch of tiles at a time. Every finished tile
+// is sent straight back, so the coordinator always knows which tiles a worker still
+// holds, and hands them out again if its connection closes or its machine stops answering
+// for 30 seconds. Pixels are seeded by their position, so the image doesn't depend on
+// which worker rendered which tile.
+//
+// Every value is a 32-bit integer in network byte order, pixels the bits of a float:
+//   worker hello:    TILE_PROTOCOL_MAGIC, TILE_PROTOCOL_VERSION, xRes, yRes
+//   coordinator:     its xRes, yRes; it closes the connection if they differ
+//   worker request:  TILE_MESSAGE_REQUEST, tiles wanted
+//   coordinator:     count, then index, x0, y0, x1, y1 of each tile; 0 once all are done
+//   worker result:   TILE_MESSAGE_RESULT, index, then RGB of each pixel row by row
+#define TILE_PROTOCOL_MAGIC 0x52545431
+#define TILE_PROTOCOL_VERSION 1
+#define TILE_MESSAGE_REQUEST 1
+#define TILE_MESSAGE_RESULT 2
+
+// Hands the tiles of an image out to worker processes and assembles what they send back
+class TileCoordinator {
+  public:
+    // Starts listening on port, so workers may connect before render is called. Throws a
+    // string if it can't.
+    TileCoordinator(int port, long width, long height, int tileSize);
+
+    // Fills image with the tiles of the workers, waiting for workers as long as any tile
+    // is missing. progress is called on the calling thread with the fraction of tiles done.
+    void render(Framebuffer &image, const std::function<void(double)> &progress);
+
+    int port() const { return listener.port(); }
+
+    // Over the last render
+    int workersConnected = 0;
+    // Tiles handed out again after the worker holding them went away
+    int tilesRedispatched = 0;
+
+  private:
+    void serveWorker(Connection &connection, Framebuffer &image);
+    // Waits for tiles to hand out and sends up to count of them, false if the connection failed
+    bool sendTiles(Connection &connection, uint32_t count, std::vector<int> &assigned);
+    bool receiveTile(Connection &connection, std::vector<int> &assigned, Framebuffer &image);
+
+    Listener listener;
+    long width;
+    long height;
+    std::vector<Tile> tiles;
+
+    std::mutex lock;
+    std::condition_variable changed;
+    std::deque<int> pending;
+    std::vector<char> finished;
+    size_t tilesFinished = 0;
+};
+
+// Renders tiles for the coordinator at host:port with renderer until it has none left,
+// retrying the connection for a while in case the coordinator is still loading the scene.
+// Asks for batchSize tiles at a time and returns how many it rendered. Throws a string
+// if the coordinator can't be reached, renders a different resolution or goes away.
+long renderForCoordinator(const std::string &host, int port, const Environment &env, ParallelRenderer &renderer,
+                          int batchSize);
+
+#endif
@@ -0,0 +1,64 @@
+#include "tileScheduler.h"
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <algorithm>
+
+using namespace std;
+
+vector<Tile> splitIntoTiles(long width, long height, int tileSize) {
+    vector<Tile> tiles;
+    for(long y = 0; y < height; y += tileSize) {
+        for(long x = 0; x < width; x += tileSize) {
+            Tile tile;
+            tile.x0 = x;
+            tile.y0 = y;
+            tile.x1 = min(width, x + tileSize);
+            tile.y1 = min(height, y + tileSize);
+            tiles.push_back(tile);
+        }
+    }
+    return tiles;
+}
+
+TileScheduler::TileScheduler(const vector<Tile> &tiles, int numWorkers) {
+    numWorkers = max(1, numWorkers);
+    for(int i = 0; i < numWorkers; i++) {
+        queues.emplace_back(new WorkQueue);
+    }
+    // Contiguous runs keep each worker on neighbouring tiles until it has to steal
+    size_t perWorker = (tiles.size() + numWorkers - 1) / numWorkers;
+    for(size_t i = 0; i < tiles.size(); i++) {
+        queues[i / perWorker]->tiles.push_back(tiles[i]);
+    }
+}
+
+bool TileScheduler::nextTile(int worker, Tile &tile) {
+    return popOwn(worker, tile) || steal(worker, tile);
+}
+
+bool TileScheduler::popOwn(int worker, Tile &tile) {
+    WorkQueue &queue = *queues[worker];
+    lock_guard<mutex> guard(queue.lock);
+    if(queue.tiles.empty()) {
+        return false;
+    }
+    tile = queue.tiles.back();
+    queue.tiles.pop_back();
+    return true;
+}
+
+bool TileScheduler::steal(int thief, Tile &tile) {
+    int numQueues = queues.size();
+    for(int offset = 1; offset < numQueues; offset++) {
+        WorkQueue &victim = *queues[(thief + offset) % numQueues];
+        lock_guard<mutex> guard(victim.lock);
+        if(!victim.tiles.empty()) {
+            tile = victim.tiles.front();
+            victim.tiles.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,41 @@
+#ifndef TILE_SCHEDULER_H
+#define TILE_SCHEDULER_H
+
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <memory>
+
+// A rectangular block of pixels, [x0, x1) by [y0, y1)
+class Tile {
+  public:
+    long x0, y0, x1, y1;
+};
+
+std::vector<Tile> splitIntoTiles(long width, long height, int tileSize);
+
+// Hands tiles out to a fixed set of worker threads. Every worker owns a deque of tiles
+// which it works through from the back; once its own deque is empty it steals from the
+// front of another worker's deque, so a few expensive tiles never leave the other cores idle.
+class TileScheduler {
+  public:
+    TileScheduler(const std::vector<Tile> &tiles, int numWorkers);
+    TileScheduler(const TileScheduler &) = delete;
+    TileScheduler &operator=(const TileScheduler &) = delete;
+
+    // Returns false once there is no work left anywhere
+    bool nextTile(int worker, Tile &tile);
+
+  private:
+    class WorkQueue {
+      public:
+        std::mutex lock;
+        std::deque<Tile> tiles;
+    };
+    bool popOwn(int worker, Tile &tile);
+    bool steal(int thief, Tile &tile);
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+};
+
+#endif
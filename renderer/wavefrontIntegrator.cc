@@ -0,0 +1,165 @@
+#include "wavefrontIntegrator.h"
+#include "shading.h"
+#include "../environment/environment.h"
+#include "../dataStructures/rayPacket.h"
+#include "../dataStructures/simd.h"
+#include <Eigen/Dense>
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <cstdint>
+
+using namespace std;
+using namespace Eigen;
+
+void WavefrontIntegrator::addCameraRay(Real x, Real y, const Random &random, int target, Real weight) {
+    PathRay path;
+    path.ray = primaryRay(x, y, context.env);
+    path.weight = Vector3r(weight, weight, weight);
+    path.target = target;
+    path.recursionLevel = context.env.recursionLevel;
+    path.imageY = y;
+    path.random = random;
+    paths.push_back(path);
+}
+
+void WavefrontIntegrator::trace(vector<Vector3r> &colors, bool usePackets) {
+    const Environment &env = context.env;
+    bool cameraRays = true;
+    while(!paths.empty()) {
+        if(cameraRays && usePackets) {
+            intersectCameraPackets();
+        } else {
+            for(PathRay &path: paths) {
+                env.intersectRay(path.ray);
+            }
+        }
+        cameraRays = false;
+        shade(colors);
+        traceShadowRays(colors);
+        paths.swap(nextPaths);
+        nextPaths.clear();
+        if(sortRays) {
+            sortByCoherence(paths);
+        }
+    }
+}
+
+void WavefrontIntegrator::intersectCameraPackets() {
+    const Environment &env = context.env;
+    for(size_t first = 0; first < paths.size();) {
+        int count = 1;
+        while(count < SIMD_WIDTH && first + count < paths.size()
+              && paths[first + count].imageY == paths[first].imageY) {
+            count++;
+        }
+        RayPacket packet;
+        for(int lane = 0; lane < count; lane++) {
+            const Ray &ray = paths[first + lane].ray;
+            packet.setRay(lane, ray.origin, ray.dir);
+        }
+        env.intersectPacket(packet);
+        for(int lane = 0; lane < count; lane++) {
+            env.resolvePacketHit(packet, lane, paths[first + lane].ray);
+        }
+        first += count;
+    }
+}
+
+void WavefrontIntegrator::shade(vector<Vector3r> &colors) {
+    const Environment &env = context.env;
+    shadowRays.clear();
+    for(size_t index = 0; index < paths.size(); index++) {
+        PathRay &path = paths[index];
+        countShadedRay(context, path.recursionLevel);
+        if(!path.ray.foundIntersect) continue;
+        const Material &mat = *path.ray.material;
+        colors[path.target] += path.weight.cwiseProduct(env.amb.cwiseProduct(mat.ambient));
+        context.random = path.random;
+        forEachShadingLight(path.ray, context, [&](const Light &light, int lightIndex, Real weight) {
+            ShadowRay shadow;
+            if(!shadowRayToLight(path.ray, light, shadow.ray, shadow.intersectCosine)) {
+                context.counters.culledShadowRays++;
+                return;
+            }
+            shadow.light = light;
+            shadow.lightIndex = lightIndex;
+            shadow.lightWeight = weight;
+            shadow.path = index;
+            shadowRays.push_back(shadow);
+        });
+        path.random = context.random;
+        if(path.recursionLevel == 0) continue;
+        Ray reflect;
+        if(reflectionRay(path.ray, reflect) && spawn(path, reflect, mat.reflective)) {
+            context.counters.reflectionRays++;
+        }
+        Ray refract;
+        if(refractionRay(path.ray, refract) && spawn(path, refract, mat.transparency)) {
+            context.counters.refractionRays++;
+        }
+    }
+}
+
+bool WavefrontIntegrator::spawn(PathRay &path, const Ray &ray, const Vector3r &coefficient) {
+    Vector3r weight = path.weight.cwiseProduct(coefficient);
+    if(weight == Vector3r(0,0,0)) return false;
+    PathRay next;
+    next.ray = ray;
+    next.weight = weight;
+    next.target = path.target;
+    next.recursionLevel = path.recursionLevel - 1;
+    next.imageY = path.imageY;
+    // Each spawned ray gets its own sequence, so reflection and refraction don't share one
+    next.random.seed(path.random.next());
+    nextPaths.push_back(next);
+    return true;
+}
+
+// Spreads the low 10 bits of value out to every third bit
+uint64_t spreadMortonBits(uint32_t value) {
+    uint64_t bits = value & 0x3ff;
+    bits = (bits | bits << 16) & 0x30000ff;
+    bits = (bits | bits << 8) & 0x300f00f;
+    bits = (bits | bits << 4) & 0x30c30c3;
+    bits = (bits | bits << 2) & 0x9249249;
+    return bits;
+}
+
+void WavefrontIntegrator::sortByCoherence(vector<PathRay> &queue) const {
+    if(queue.size() < 2) return;
+    // Origins are placed on a 1024 cell grid over their own bounds, since the scene's
+    // bounds can be far larger than where the rays start
+    Vector3r low = queue[0].ray.origin, high = low;
+    for(const PathRay &path: queue) {
+        low = low.cwiseMin(path.ray.origin);
+        high = high.cwiseMax(path.ray.origin);
+    }
+    Vector3r scale = (high - low).cwiseMax(Vector3r::Constant(1e-12)).cwiseInverse() * Real(1023);
+    vector<pair<uint64_t, int>> keys(queue.size());
+    for(size_t i = 0; i < queue.size(); i++) {
+        const Ray &ray = queue[i].ray;
+        uint64_t octant = (ray.dir(0) < 0) | (ray.dir(1) < 0) << 1 | (ray.dir(2) < 0) << 2;
+        Vector3r cell = (ray.origin - low).cwiseProduct(scale);
+        uint64_t morton = spreadMortonBits(cell(0)) | spreadMortonBits(cell(1)) << 1 | spreadMortonBits(cell(2)) << 2;
+        keys[i] = make_pair(octant << 30 | morton, i);
+    }
+    sort(keys.begin(), keys.end());
+    vector<PathRay> sorted;
+    sorted.reserve(queue.size());
+    for(const auto &key: keys) {
+        sorted.push_back(queue[key.second]);
+    }
+    queue.swap(sorted);
+}
+
+void WavefrontIntegrator::traceShadowRays(vector<Vector3r> &colors) {
+    for(const ShadowRay &shadow: shadowRays) {
+        Vector3r shadowCoeff = getShadowCoeff(shadow.ray, context, shadow.lightIndex) * shadow.lightWeight;
+        if(shadowCoeff == Vector3r(0,0,0)) continue;
+        const PathRay &path = paths[shadow.path];
+        Vector3r color(0,0,0);
+        addLitColor(path.ray, *path.ray.material, shadow.light, shadow.ray.dir, shadow.intersectCosine, shadowCoeff, color);
+        colors[path.target] += path.weight.cwiseProduct(color);
+    }
+}
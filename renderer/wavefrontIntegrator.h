@@ -0,0 +1,74 @@
+#ifndef WAVEFRONT_INTEGRATOR_H
+#define WAVEFRONT_INTEGRATOR_H
+
+#include "renderContext.h"
+#include "../dataStructures/ray.h"
+#include "../dataStructures/light.h"
+#include "../dataStructures/random.h"
+#include <Eigen/Dense>
+#include <vector>
+
+// A ray on its way through the scene, with the weight its colour carries into the pixel
+class PathRay {
+  public:
+    Ray ray;
+    Vector3r weight;
+    int target;
+    int recursionLevel;
+    // Camera rays on the same image row may share a packet
+    Real imageY;
+    Random random;
+};
+
+// Shadow ray towards a light from the hit of paths[path]
+class ShadowRay {
+  public:
+    Ray ray;
+    Light light;
+    int lightIndex;
+    Real lightWeight;
+    Real intersectCosine;
+    int path;
+};
+
+// Traces rays breadth first instead of recursing for every pixel. Each stage works through
+// a whole queue: intersection finds the hits of every queued ray, shading adds their
+// ambient light and queues their shadow, reflection and refraction rays, and the shadow
+// stage traces the shadow rays and adds the light that gets through. Reflection and
+// refraction rays carry the product of the coefficients along their path as a weight, so
+// the colour of each hit goes straight into its pixel, and rays whose weight is zero are
+// dropped. The image matches the recursive integrator up to rounding.
+//
+// Reflection and refraction rays leave their hits in every direction, so tracing them in
+// pixel order jumps around the scene. Sorting them first by the octant of their direction
+// and then along a Morton curve through their origins lets neighbouring rays in the queue
+// walk the same BVH nodes and triangles while they are still in cache.
+class WavefrontIntegrator {
+  public:
+    // With sortRays, reflection and refraction rays are sorted by direction and origin
+    // before they are traced
+    WavefrontIntegrator(RenderContext &context, bool sortRays = false): context(context), sortRays(sortRays) {}
+
+    // Queues the primary ray through image point (x, y), whose colour is added to
+    // colors[target] scaled by weight. The path draws its random numbers from random.
+    void addCameraRay(Real x, Real y, const Random &random, int target, Real weight);
+    // Traces every queued ray and the rays they spawn. With packets, camera rays are
+    // intersected SIMD_WIDTH at a time in the order they were queued.
+    void trace(std::vector<Vector3r> &colors, bool usePackets);
+
+  private:
+    RenderContext &context;
+    bool sortRays;
+    std::vector<PathRay> paths;
+    std::vector<PathRay> nextPaths;
+    std::vector<ShadowRay> shadowRays;
+
+    void intersectCameraPackets();
+    void shade(std::vector<Vector3r> &colors);
+    void traceShadowRays(std::vector<Vector3r> &colors);
+    // Queues a ray from the hit of path, unless its weight is zero
+    bool spawn(PathRay &path, const Ray &ray, const Vector3r &coefficient);
+    void sortByCoherence(std::vector<PathRay> &queue) const;
+};
+
+#endif
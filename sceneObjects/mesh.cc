@@ -0,0 +1,391 @@
+#include "mesh.h"
+#include "objFile.h"
+#include "meshCache.h"
+#include "../dataStructures/parallelFor.h"
+#include "../dataStructures/octNormal.h"
+#include "../dataStructures/traversalCounters.h"
+#include <Eigen/Dense>
+#include <fstream>
+#include <string>
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+
+using namespace Eigen;
+using namespace std;
+
+template<typename T>
+size_t vectorBytes(const vector<T> &elements) {
+    return elements.capacity()*sizeof(T);
+}
+
+MeshMemory &MeshMemory::operator+=(const MeshMemory &other) {
+    faces += other.faces;
+    triangles += other.triangles;
+    normals += other.normals;
+    materials += other.materials;
+    bvh += other.bvh;
+    build += other.build;
+    return *this;
+}
+
+MeshMemory Mesh::memory() const {
+    MeshMemory memory;
+    memory.faces = numFaces;
+    memory.triangles = 9*triangles.size()*sizeof(Real);
+    memory.normals = normals.size()*sizeof(Vector3r) + octNormals.size()*sizeof(uint32_t)
+                   + cornerNormals.size()*sizeof(uint32_t);
+    memory.materials = faceMaterials.size()*sizeof(int);
+    memory.bvh = bvh.nodes.size()*sizeof(BVHNode) + vectorBytes(bvh.primitiveIndices);
+    memory.build = buildBytes;
+    return memory;
+}
+
+// Remembers the most memory held while building, counting the build data, what has
+// been built so far and extra bytes of temporary data
+void Mesh::noteBuildBytes(size_t extra) {
+    size_t held = vectorBytes(vertices) + vectorBytes(faceVertices) + vectorBytes(faceNormals)
+                + vectorBytes(faceMaterialIndices) + vectorBytes(faceCornerNormals)
+                + memory().total() + extra;
+    buildBytes = max(buildBytes, held);
+}
+
+void Mesh::processMaterialStatement(const ObjMaterialStatement &statement) {
+    if(statement.isLibrary) {
+        materialFactory(materials, statement.argument);
+        materialLibraries.push_back(statement.argument);
+        return;
+    }
+    for(size_t i = 0; i < materials.size(); i++) {
+        if(materials[i].name == statement.argument) {
+            currentMaterial = i;
+            break;
+        }
+    }
+}
+
+void Mesh::buildFromWavefrontObjectFile(const string &fileName) {
+    ObjFile obj = readObjFile(fileName);
+    vertices.swap(obj.vertices);
+    faceVertices.swap(obj.triangles);
+    faceMaterialIndices.reserve(faceVertices.size());
+    size_t nextStatement = 0;
+    for(size_t f = 0; f < faceVertices.size(); f++) {
+        while(nextStatement < obj.materialStatements.size()
+              && obj.materialStatements[nextStatement].firstTriangle <= f) {
+            processMaterialStatement(obj.materialStatements[nextStatement++]);
+        }
+        faceMaterialIndices.push_back(currentMaterial);
+    }
+    // Libraries named after the last face are still loaded, as they always were
+    while(nextStatement < obj.materialStatements.size()) {
+        processMaterialStatement(obj.materialStatements[nextStatement++]);
+    }
+    numFaces = faceVertices.size();
+    noteBuildBytes(0);
+}
+
+Mesh::Mesh(const string &fileName, double smoothingCutoff, const MeshOptions &options)
+  : smoothingCutoff(smoothingCutoff) {
+    string cachePath;
+    uint64_t sourceHash = 0;
+    if(!options.cacheDirectory.empty()) {
+        sourceHash = meshSourceHash(fileName, smoothingCutoff, options.octNormals);
+        cachePath = meshCachePath(options.cacheDirectory, sourceHash);
+        if(loadCache(cachePath, sourceHash)) {
+            loadedFromCache = true;
+            return;
+        }
+    }
+    buildFromWavefrontObjectFile(fileName);
+    auto normalsStart = chrono::steady_clock::now();
+    calculateSurfaceNormals();
+    normalsSeconds = chrono::duration<double>(chrono::steady_clock::now() - normalsStart).count();
+    buildBVH();
+    buildRenderBuffers(options.octNormals);
+    releaseBuildData();
+    if(!cachePath.empty()) {
+        saveCache(cachePath, sourceHash);
+    }
+}
+
+void Mesh::buildBVH() {
+    auto startTime = chrono::steady_clock::now();
+    vector<BoundingBox> faceBounds;
+    faceBounds.reserve(faceVertices.size());
+    for(const Vector3i &face: faceVertices) {
+        BoundingBox box;
+        for(int i = 0; i < 3; i++) {
+            box.extend(vertices[face(i)]);
+        }
+        faceBounds.push_back(box);
+    }
+    bvh.build(faceBounds);
+    noteBuildBytes(vectorBytes(faceBounds));
+    bvhBuildSeconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+}
+
+// Faces are stored in BVH leaf order, so each leaf is a contiguous run of faces
+void Mesh::buildRenderBuffers(bool octEncodeNormals) {
+    triangles.reserve(faceVertices.size());
+    cornerNormals.reserve(3*faceVertices.size());
+    faceMaterials.reserve(faceVertices.size());
+    for(int index: bvh.primitiveIndices) {
+        const Vector3i &face = faceVertices[index];
+        triangles.push_back(vertices[face(0)], vertices[face(1)], vertices[face(2)]);
+        for(int i = 0; i < 3; i++) {
+            cornerNormals.push_back(faceCornerNormals[3*index + i]);
+        }
+        faceMaterials.push_back(faceMaterialIndices[index]);
+    }
+    if(octEncodeNormals) {
+        octNormals.reserve(normals.size());
+        for(const Vector3r &normal: normals) {
+            octNormals.push_back(encodeOctNormal(normal));
+        }
+        noteBuildBytes(0);
+        normals = Buffer<Vector3r>();
+    }
+    noteBuildBytes(0);
+}
+
+void Mesh::releaseBuildData() {
+    vector<Vector3r>().swap(vertices);
+    vector<Vector3i>().swap(faceVertices);
+    vector<Vector3r>().swap(faceNormals);
+    vector<int>().swap(faceMaterialIndices);
+    vector<uint32_t>().swap(faceCornerNormals);
+    vector<int>().swap(bvh.primitiveIndices);
+}
+
+int Mesh::numBVHNodes() const {
+    return bvh.nodes.size();
+}
+
+BoundingBox Mesh::getBounds() const {
+    return bvh.bounds();
+}
+
+// Cosines this close to the cosine of the cutoff are decided with acos, exactly as the
+// angle used to be compared, so rounding can't move a face to the other side of the cutoff
+#define SMOOTHING_COSINE_MARGIN 1e-5
+
+bool Mesh::withinSmoothingCutoff(Real cosine, Real cosineCutoff) const {
+    if(abs(cosine - cosineCutoff) > SMOOTHING_COSINE_MARGIN) {
+        return cosine > cosineCutoff;
+    }
+    return abs(acos(cosine)) <= smoothingCutoff;
+}
+
+void Mesh::calculateSurfaceNormals() {
+    faceNormals.resize(faceVertices.size());
+    parallelFor(faceVertices.size(), [&](size_t begin, size_t end) {
+        for(size_t f = begin; f < end; f++) {
+            const Vector3r &vertex1 = vertices[faceVertices[f](0)];
+            const Vector3r &vertex2 = vertices[faceVertices[f](1)];
+            const Vector3r &vertex3 = vertices[faceVertices[f](2)];
+            Vector3r surfaceNorm = (vertex1-vertex2).cross(vertex1-vertex3);
+            faceNormals[f] = surfaceNorm / surfaceNorm.norm();
+        }
+    });
+    if(smoothingCutoff >= 0.001) {
+        calculateSmoothedNormals();
+        return;
+    }
+    // Unsmoothed faces use their own normal at every corner
+    faceCornerNormals.resize(3*faceVertices.size());
+    normals.reserve(faceNormals.size());
+    for(size_t f = 0; f < faceNormals.size(); f++) {
+        normals.push_back(faceNormals[f]);
+        for(int i = 0; i < 3; i++) {
+            faceCornerNormals[3*f + i] = f;
+        }
+    }
+    noteBuildBytes(0);
+}
+
+// Each corner's normal is the sum of the normals of the faces around its vertex that are
+// within the cutoff of its own face. Corners of a vertex usually end up with the same
+// normal, so each distinct normal is stored once.
+void Mesh::calculateSmoothedNormals() {
+    // Faces around each vertex, in increasing order so the normals are summed in the
+    // same order as always: vertexFaces[vertexFaceStart[v]] up to vertexFaceStart[v+1]
+    size_t numVertices = vertices.size();
+    vector<int> vertexFaceStart(numVertices + 1, 0);
+    for(const Vector3i &face: faceVertices) {
+        for(int i = 0; i < 3; i++) {
+            vertexFaceStart[face(i) + 1]++;
+        }
+    }
+    for(size_t v = 0; v < numVertices; v++) {
+        vertexFaceStart[v + 1] += vertexFaceStart[v];
+    }
+    vector<int> vertexFaces(vertexFaceStart.back());
+    vector<int> nextSlot(vertexFaceStart.begin(), vertexFaceStart.end() - 1);
+    for(size_t f = 0; f < faceVertices.size(); f++) {
+        for(int i = 0; i < 3; i++) {
+            vertexFaces[nextSlot[faceVertices[f](i)]++] = f;
+        }
+    }
+    vector<int>().swap(nextSlot);
+
+    // The distinct normals of a vertex are gathered at the start of its run of slots, and
+    // slotNormal says which of them the face in each slot uses at that vertex
+    vector<Vector3r> slotNormals(vertexFaces.size());
+    vector<int> slotNormal(vertexFaces.size());
+    vector<int> vertexNormalCount(numVertices);
+    // Every pair of faces is within the cutoff once it reaches the largest possible angle
+    bool smoothAll = smoothingCutoff >= acos(Real(-1));
+    Real cosineCutoff = cos(Real(smoothingCutoff));
+    parallelFor(numVertices, [&](size_t begin, size_t end) {
+        for(size_t v = begin; v < end; v++) {
+            int first = vertexFaceStart[v];
+            int count = 0;
+            for(int slot = first; slot < vertexFaceStart[v + 1]; slot++) {
+                const Vector3r &faceNormal = faceNormals[vertexFaces[slot]];
+                Vector3r cumulativeNormal(0,0,0);
+                for(int other = first; other < vertexFaceStart[v + 1]; other++) {
+                    const Vector3r &otherNormal = faceNormals[vertexFaces[other]];
+                    Real cosine = max<Real>(-1, min<Real>(1, otherNormal.dot(faceNormal)));
+                    if(smoothAll || withinSmoothingCutoff(cosine, cosineCutoff)) {
+                        cumulativeNormal += otherNormal;
+                    }
+                }
+                Vector3r normal = cumulativeNormal / cumulativeNormal.norm();
+                int match = 0;
+                while(match < count && slotNormals[first + match] != normal) match++;
+                if(match == count) slotNormals[first + count++] = normal;
+                slotNormal[slot] = match;
+            }
+            vertexNormalCount[v] = count;
+        }
+    }, 256);
+
+    vector<uint32_t> vertexNormalStart(numVertices);
+    size_t numNormals = 0;
+    for(size_t v = 0; v < numVertices; v++) {
+        vertexNormalStart[v] = numNormals;
+        numNormals += vertexNormalCount[v];
+    }
+    normals.reserve(numNormals);
+    for(size_t v = 0; v < numVertices; v++) {
+        for(int i = 0; i < vertexNormalCount[v]; i++) {
+            normals.push_back(slotNormals[vertexFaceStart[v] + i]);
+        }
+    }
+    faceCornerNormals.resize(3*faceVertices.size());
+    parallelFor(numVertices, [&](size_t begin, size_t end) {
+        for(size_t v = begin; v < end; v++) {
+            for(int slot = vertexFaceStart[v]; slot < vertexFaceStart[v + 1]; slot++) {
+                int f = vertexFaces[slot];
+                for(int i = 0; i < 3; i++) {
+                    if(faceVertices[f](i) == (int)v) {
+                        faceCornerNormals[3*f + i] = vertexNormalStart[v] + slotNormal[slot];
+                    }
+                }
+            }
+        }
+    });
+    noteBuildBytes(vectorBytes(vertexFaceStart) + vectorBytes(vertexFaces) + vectorBytes(slotNormals)
+                 + vectorBytes(slotNormal) + vectorBytes(vertexNormalCount) + vectorBytes(vertexNormalStart));
+}
+
+bool Mesh::faceIntersectRay(int faceIndex, Ray &ray) const {
+    traversalCounters().triangleTests++;
+    Real distance, beta, gamma;
+    if(!triangles.intersect(faceIndex, ray.origin, ray.dir, distance, beta, gamma)
+      || (ray.foundIntersect && (distance-0.00001) >= ray.distanceToIntersect)) {
+        return false;
+    }
+    ray.distanceToIntersect = distance;
+    ray.primitiveIndex = faceIndex;
+    ray.beta = beta;
+    ray.gamma = gamma;
+    ray.foundIntersect = true;
+    return true;
+}
+
+Vector3r Mesh::cornerNormal(uint32_t index) const {
+    return octNormals.empty() ? normals[index] : decodeOctNormal(octNormals[index]);
+}
+
+Vector3r Mesh::interpolateNormal(int faceIndex, Real beta, Real gamma) const {
+    const uint32_t *corners = &cornerNormals[3*faceIndex];
+    Vector3r normal = cornerNormal(corners[0])*(1-beta-gamma) + cornerNormal(corners[1])*beta
+                    + cornerNormal(corners[2])*gamma;
+    return normal / normal.norm();
+}
+
+const Material &Mesh::faceMaterial(int faceIndex) const {
+    return materials[faceMaterials[faceIndex]];
+}
+
+bool Mesh::intersectRay(Ray &ray) const {
+    bool hit = false;
+    bvh.traverse(ray, [&](int faceIndex) {
+        hit = faceIntersectRay(faceIndex, ray) || hit;
+        return false;
+    });
+    return hit;
+}
+
+bool Mesh::faceBlocksRay(int faceIndex, const Ray &ray) const {
+    traversalCounters().triangleTests++;
+    Real distance, beta, gamma;
+    return triangles.intersect(faceIndex, ray.origin, ray.dir, distance, beta, gamma)
+        && (!ray.foundIntersect || (distance-0.00001) < ray.distanceToIntersect);
+}
+
+bool Mesh::occludes(const Ray &ray, int &faceIndex) const {
+    bool blocked = false;
+    bvh.traverse(ray, [&](int face) {
+        blocked = faceBlocksRay(face, ray);
+        if(blocked) faceIndex = face;
+        return blocked;
+    });
+    return blocked;
+}
+
+bool Mesh::attenuate(const Ray &ray, Vector3r &transmission, const vector<Material> &materials) const {
+    bool blocked = false;
+    bvh.traverse(ray, [&](int faceIndex) {
+        if(faceBlocksRay(faceIndex, ray)) {
+            transmission = transmission.cwiseProduct(materials[faceMaterials[faceIndex]].transparency);
+            blocked = transmission == Vector3r(0,0,0);
+        }
+        return blocked;
+    });
+    return blocked;
+}
+
+int Mesh::intersectPacket(RayPacket &packet) const {
+    SimdReal origin[3], dir[3];
+    for(int axis = 0; axis < 3; axis++) {
+        origin[axis] = packet.originAxis(axis);
+        dir[axis] = packet.dirAxis(axis);
+    }
+    int updatedLanes = 0;
+    TraversalCounters &counters = traversalCounters();
+    bvh.traversePacket(packet, [&](int faceIndex) {
+        counters.triangleTests += SIMD_WIDTH;
+        SimdReal distance, beta, gamma;
+        int hits = triangles.intersectPacket(faceIndex, origin, dir, distance, beta, gamma);
+        if(!hits) return;
+        hits &= ((distance - SimdReal(0.00001)) < packet.distances()).bits();
+        if(!hits) return;
+        alignas(SIMD_ALIGNMENT) Real hitDistance[SIMD_WIDTH], hitBeta[SIMD_WIDTH], hitGamma[SIMD_WIDTH];
+        distance.store(hitDistance);
+        beta.store(hitBeta);
+        gamma.store(hitGamma);
+        for(int lane = 0; lane < SIMD_WIDTH; lane++) {
+            if(hits & (1 << lane)) {
+                packet.distance[lane] = hitDistance[lane];
+                packet.beta[lane] = hitBeta[lane];
+                packet.gamma[lane] = hitGamma[lane];
+                packet.hitPrimitive[lane] = faceIndex;
+            }
+        }
+        updatedLanes |= hits;
+    });
+    return updatedLanes;
+}
@@ -0,0 +1,110 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include "../dataStructures/material.h"
+#include "../dataStructures/ray.h"
+#include "../dataStructures/rayPacket.h"
+#include "../dataStructures/bvh.h"
+#include "../dataStructures/triangleBuffer.h"
+#include "../dataStructures/boundingBox.h"
+#include "../dataStructures/buffer.h"
+#include "objFile.h"
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+#include <cstdint>
+
+// How meshes are built and stored
+class MeshOptions {
+  public:
+    // Directory of built meshes reused between runs, no caching if empty
+    std::string cacheDirectory;
+    // Store normals in 4 bytes each (see octNormal.h) instead of three Reals
+    bool octNormals = false;
+};
+
+// Bytes held by the parts of a mesh
+class MeshMemory {
+  public:
+    size_t faces = 0;
+    size_t triangles = 0;
+    size_t normals = 0;
+    size_t materials = 0;
+    size_t bvh = 0;
+    // Largest amount held at once while building, zero if the mesh came from the cache
+    size_t build = 0;
+
+    size_t total() const { return triangles + normals + materials + bvh; }
+    MeshMemory &operator+=(const MeshMemory &other);
+};
+
+// Triangle geometry loaded from a Wavefront Object file, kept in the file's own coordinate
+// space. A mesh is shared by every Model placing it in the scene.
+class Mesh {
+    public:
+        Mesh() = delete;
+        Mesh(const Mesh &) = default;
+        // With a cache directory, a mesh built from the same file contents, cutoff and
+        // options by an earlier run is mapped from the cache instead of being built again
+        Mesh(const std::string &fileName, double smoothingCutoff, const MeshOptions &options = MeshOptions());
+
+        std::vector<Material> materials;
+        // Returns true if the ray (in mesh space) was updated with a closer hit
+        bool intersectRay(Ray &ray) const;
+        // Any-hit queries, as in SceneObject
+        bool occludes(const Ray &ray, int &faceIndex) const;
+        bool faceBlocksRay(int faceIndex, const Ray &) const;
+        // Transparency comes from materials, which faces index as they do the mesh's own
+        bool attenuate(const Ray &ray, Vector3r &transmission, const std::vector<Material> &materials) const;
+        // Returns one bit per lane of the packet (in mesh space) that found a closer hit
+        int intersectPacket(RayPacket &packet) const;
+        // Smoothed normal at a point of a face, given its barycentric weights
+        Vector3r interpolateNormal(int faceIndex, Real beta, Real gamma) const;
+        const Material &faceMaterial(int faceIndex) const;
+        int faceMaterialIndex(int faceIndex) const { return faceMaterials[faceIndex]; }
+        BoundingBox getBounds() const;
+        int numFaces = 0;
+        int numBVHNodes() const;
+        double normalsSeconds = 0;
+        double bvhBuildSeconds = 0;
+        bool loadedFromCache = false;
+        MeshMemory memory() const;
+
+    private:
+        double smoothingCutoff;
+        std::vector<std::string> materialLibraries;
+        BVH bvh;
+        // Faces in BVH leaf order, ready for intersection
+        TriangleBuffer triangles;
+        // Distinct smoothed normals, held in normals or packed in octNormals, and which of
+        // them each face's three corners use
+        Buffer<Vector3r> normals;
+        Buffer<uint32_t> octNormals;
+        Buffer<uint32_t> cornerNormals;
+        Buffer<int> faceMaterials;
+        size_t buildBytes = 0;
+
+        // Only used while building, in file order
+        int currentMaterial = -1;
+        std::vector<Vector3r> vertices;
+        std::vector<Eigen::Vector3i> faceVertices;
+        std::vector<Vector3r> faceNormals;
+        std::vector<int> faceMaterialIndices;
+        std::vector<uint32_t> faceCornerNormals;
+        void buildFromWavefrontObjectFile(const std::string &fileName);
+        void processMaterialStatement(const ObjMaterialStatement &statement);
+        bool faceIntersectRay(int faceIndex, Ray &) const;
+        void calculateSurfaceNormals();
+        void calculateSmoothedNormals();
+        Vector3r cornerNormal(uint32_t index) const;
+        bool withinSmoothingCutoff(Real cosine, Real cosineCutoff) const;
+        void buildBVH();
+        void buildRenderBuffers(bool octEncodeNormals);
+        void releaseBuildData();
+        void noteBuildBytes(size_t extra);
+        // Defined in meshCache.cc
+        bool loadCache(const std::string &path, uint64_t sourceHash);
+        void saveCache(const std::string &path, uint64_t sourceHash) const;
+};
+
+#endif
@@ -0,0 +1,307 @@
+#include "meshCache.h"
+#include "mesh.h"
+#include "../dataStructures/mappedFile.h"
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Sections of the file start on cache line boundaries
+#define MESH_CACHE_ALIGNMENT 64
+
+// A cache file is this header, the material libraries the mesh was built with, its
+// materials, and then the arrays a Mesh renders from, stored exactly as they are in
+// memory so they can be used in place once the file is mapped.
+class MeshCacheHeader {
+  public:
+    char magic[8];
+    uint32_t version;
+    uint32_t realSize;
+    uint32_t nodeSize;
+    uint32_t materialSize;
+    uint64_t sourceHash;
+    uint64_t fileSize;
+    uint64_t numFaces;
+    uint64_t numNodes;
+    uint64_t numNormals;
+    uint64_t numOctNormals;
+    uint64_t numMaterials;
+    uint64_t numLibraries;
+    uint64_t librariesOffset;
+    uint64_t materialsOffset;
+    uint64_t nodesOffset;
+    uint64_t trianglesOffset[9];
+    uint64_t normalsOffset;
+    uint64_t octNormalsOffset;
+    uint64_t cornerNormalsOffset;
+    uint64_t faceMaterialsOffset;
+};
+
+const char meshCacheMagic[8] = {'R', 'T', 'M', 'E', 'S', 'H', '\n', '\0'};
+
+// Material without its name, which is only needed while reading the model file
+class MaterialRecord {
+  public:
+    Real ambient[3], diffuse[3], specular[3], reflective[3], transparency[3];
+    Real specularExponent;
+    Real refractiveIndex;
+    int32_t illuminationModel;
+};
+
+// Library records are followed by the characters of the path, padded so that the next
+// record is aligned
+class LibraryRecord {
+  public:
+    uint64_t contentHash;
+    uint64_t pathLength;
+};
+
+uint64_t hashBytes(const char *data, size_t size, uint64_t hash) {
+    size_t i = 0;
+    for(; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        hash = ((hash << 5 | hash >> 59) ^ word) * 0x9E3779B97F4A7C15ULL;
+    }
+    for(; i < size; i++) {
+        hash = (hash ^ (unsigned char)data[i]) * 1099511628211ULL;
+    }
+    return hash ^ (hash >> 31);
+}
+
+uint64_t hashFile(const string &fileName) {
+    MappedFile file(fileName);
+    return hashBytes(file.begin(), file.size());
+}
+
+uint64_t meshSourceHash(const string &fileName, double smoothingCutoff, bool octNormals) {
+    uint64_t hash = hashFile(fileName);
+    uint32_t settings[3] = {MESH_CACHE_VERSION, (uint32_t)sizeof(Real), octNormals};
+    hash = hashBytes(reinterpret_cast<const char *>(&smoothingCutoff), sizeof(smoothingCutoff), hash);
+    return hashBytes(reinterpret_cast<const char *>(settings), sizeof(settings), hash);
+}
+
+string meshCachePath(const string &cacheDirectory, uint64_t sourceHash) {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.mesh", (unsigned long long)sourceHash);
+    return cacheDirectory + "/" + name;
+}
+
+MaterialRecord materialToRecord(const Material &material) {
+    MaterialRecord record;
+    // Clear the padding too, so the same mesh always produces the same file
+    memset(&record, 0, sizeof(record));
+    for(int i = 0; i < 3; i++) {
+        record.ambient[i] = material.ambient(i);
+        record.diffuse[i] = material.diffuse(i);
+        record.specular[i] = material.specular(i);
+        record.reflective[i] = material.reflective(i);
+        record.transparency[i] = material.transparency(i);
+    }
+    record.specularExponent = material.specularExponent;
+    record.refractiveIndex = material.refractiveIndex;
+    record.illuminationModel = material.illuminationModel;
+    return record;
+}
+
+Material recordToMaterial(const MaterialRecord &record) {
+    Material material;
+    material.ambient = Vector3r(record.ambient[0], record.ambient[1], record.ambient[2]);
+    material.diffuse = Vector3r(record.diffuse[0], record.diffuse[1], record.diffuse[2]);
+    material.specular = Vector3r(record.specular[0], record.specular[1], record.specular[2]);
+    material.reflective = Vector3r(record.reflective[0], record.reflective[1], record.reflective[2]);
+    material.transparency = Vector3r(record.transparency[0], record.transparency[1], record.transparency[2]);
+    material.specularExponent = record.specularExponent;
+    material.refractiveIndex = record.refractiveIndex;
+    material.illuminationModel = record.illuminationModel;
+    return material;
+}
+
+// Writes the sections of a cache file, padding each one to MESH_CACHE_ALIGNMENT
+class CacheWriter {
+  public:
+    ofstream output;
+    uint64_t offset = 0;
+
+    CacheWriter(const string &path): output(path, ios::binary) {}
+
+    uint64_t write(const void *data, size_t size) {
+        uint64_t start = offset;
+        output.write(static_cast<const char *>(data), size);
+        offset += size;
+        return start;
+    }
+
+    // Pads with zeros up to a multiple of alignment, which is at most MESH_CACHE_ALIGNMENT
+    void pad(size_t alignment) {
+        static const char padding[MESH_CACHE_ALIGNMENT] = {};
+        size_t extra = offset % alignment;
+        if(extra) write(padding, alignment - extra);
+    }
+
+    uint64_t beginSection() {
+        pad(MESH_CACHE_ALIGNMENT);
+        return offset;
+    }
+
+    template<typename T>
+    uint64_t writeSection(const T *data, size_t count) {
+        uint64_t start = beginSection();
+        write(data, count*sizeof(T));
+        return start;
+    }
+};
+
+void Mesh::saveCache(const string &path, uint64_t sourceHash) const {
+    string directory = path.substr(0, path.find_last_of('/'));
+    mkdir(directory.c_str(), 0755);
+    // Written under a name of its own first, so other runs, which may be writing the same
+    // mesh at the same time, never map a partial file
+    string temporaryPath = path + ".XXXXXX";
+    int descriptor = mkstemp(&temporaryPath[0]);
+    if(descriptor < 0) {
+        cerr << "Warning: couldn't write mesh cache file " << path << '\n';
+        return;
+    }
+    // mkstemp makes the file readable by its owner alone
+    fchmod(descriptor, 0644);
+    close(descriptor);
+    CacheWriter writer(temporaryPath);
+    MeshCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    writer.write(&header, sizeof(header));
+
+    header.numLibraries = materialLibraries.size();
+    header.librariesOffset = writer.beginSection();
+    for(const string &library: materialLibraries) {
+        LibraryRecord record = {hashFile(library), library.size()};
+        writer.write(&record, sizeof(record));
+        writer.write(library.data(), library.size());
+        writer.pad(alignof(LibraryRecord));
+    }
+    vector<MaterialRecord> materialRecords;
+    for(const Material &material: materials) {
+        materialRecords.push_back(materialToRecord(material));
+    }
+    header.numMaterials = materialRecords.size();
+    header.materialsOffset = writer.writeSection(materialRecords.data(), materialRecords.size());
+    header.numNodes = bvh.nodes.size();
+    header.nodesOffset = writer.writeSection(bvh.nodes.data(), bvh.nodes.size());
+    header.numFaces = numFaces;
+    const Buffer<Real> *components[9] = {&triangles.v0x, &triangles.v0y, &triangles.v0z,
+                                         &triangles.e1x, &triangles.e1y, &triangles.e1z,
+                                         &triangles.e2x, &triangles.e2y, &triangles.e2z};
+    for(int i = 0; i < 9; i++) {
+        header.trianglesOffset[i] = writer.writeSection(components[i]->data(), components[i]->size());
+    }
+    header.numNormals = normals.size();
+    header.normalsOffset = writer.writeSection(normals.data(), normals.size());
+    header.numOctNormals = octNormals.size();
+    header.octNormalsOffset = writer.writeSection(octNormals.data(), octNormals.size());
+    header.cornerNormalsOffset = writer.writeSection(cornerNormals.data(), cornerNormals.size());
+    header.faceMaterialsOffset = writer.writeSection(faceMaterials.data(), faceMaterials.size());
+
+    memcpy(header.magic, meshCacheMagic, sizeof(header.magic));
+    header.version = MESH_CACHE_VERSION;
+    header.realSize = sizeof(Real);
+    header.nodeSize = sizeof(BVHNode);
+    header.materialSize = sizeof(MaterialRecord);
+    header.sourceHash = sourceHash;
+    header.fileSize = writer.offset;
+    writer.output.seekp(0);
+    writer.output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    writer.output.close();
+    if(!writer.output || rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        remove(temporaryPath.c_str());
+        cerr << "Warning: couldn't write mesh cache file " << path << '\n';
+    }
+}
+
+// Checks that count elements of T at offset lie inside the file and are aligned for T
+template<typename T>
+bool sectionFits(const MappedFile &file, uint64_t offset, uint64_t count) {
+    return offset % alignof(T) == 0 && offset <= file.size()
+        && count <= (file.size() - offset) / sizeof(T);
+}
+
+template<typename T>
+const T *sectionData(const MappedFile &file, uint64_t offset) {
+    return reinterpret_cast<const T *>(file.begin() + offset);
+}
+
+bool Mesh::loadCache(const string &path, uint64_t sourceHash) {
+    shared_ptr<const MappedFile> file;
+    try {
+        // The nodes and triangles are read in no particular order for the whole render
+        file = make_shared<const MappedFile>(path, MappedFile::WholeFile);
+    } catch(string) {
+        return false;
+    }
+    if(file->size() < sizeof(MeshCacheHeader)) return false;
+    const MeshCacheHeader &header = *sectionData<MeshCacheHeader>(*file, 0);
+    if(memcmp(header.magic, meshCacheMagic, sizeof(header.magic)) != 0
+       || header.version != MESH_CACHE_VERSION || header.realSize != sizeof(Real)
+       || header.nodeSize != sizeof(BVHNode) || header.materialSize != sizeof(MaterialRecord)
+       || header.sourceHash != sourceHash || header.fileSize != file->size()) {
+        return false;
+    }
+    if(!sectionFits<MaterialRecord>(*file, header.materialsOffset, header.numMaterials)
+       || !sectionFits<BVHNode>(*file, header.nodesOffset, header.numNodes)
+       || !sectionFits<Vector3r>(*file, header.normalsOffset, header.numNormals)
+       || !sectionFits<uint32_t>(*file, header.octNormalsOffset, header.numOctNormals)
+       || !sectionFits<uint32_t>(*file, header.cornerNormalsOffset, 3*header.numFaces)
+       || !sectionFits<int>(*file, header.faceMaterialsOffset, header.numFaces)) {
+        return false;
+    }
+    for(int i = 0; i < 9; i++) {
+        if(!sectionFits<Real>(*file, header.trianglesOffset[i], header.numFaces)) return false;
+    }
+
+    // The materials must still be the ones the mesh was built with
+    vector<string> libraries;
+    uint64_t offset = header.librariesOffset;
+    for(uint64_t i = 0; i < header.numLibraries; i++) {
+        if(!sectionFits<LibraryRecord>(*file, offset, 1)) return false;
+        const LibraryRecord &record = *sectionData<LibraryRecord>(*file, offset);
+        offset += sizeof(LibraryRecord);
+        if(!sectionFits<char>(*file, offset, record.pathLength)) return false;
+        string library(file->begin() + offset, record.pathLength);
+        offset += record.pathLength;
+        offset += (alignof(LibraryRecord) - offset % alignof(LibraryRecord)) % alignof(LibraryRecord);
+        try {
+            if(hashFile(library) != record.contentHash) return false;
+        } catch(string) {
+            return false;
+        }
+        libraries.push_back(library);
+    }
+
+    materialLibraries = libraries;
+    materials.clear();
+    const MaterialRecord *materialRecords = sectionData<MaterialRecord>(*file, header.materialsOffset);
+    for(uint64_t i = 0; i < header.numMaterials; i++) {
+        materials.push_back(recordToMaterial(materialRecords[i]));
+    }
+    numFaces = header.numFaces;
+    bvh.nodes.view(sectionData<BVHNode>(*file, header.nodesOffset), header.numNodes, file);
+    Buffer<Real> *components[9] = {&triangles.v0x, &triangles.v0y, &triangles.v0z,
+                                   &triangles.e1x, &triangles.e1y, &triangles.e1z,
+                                   &triangles.e2x, &triangles.e2y, &triangles.e2z};
+    for(int i = 0; i < 9; i++) {
+        components[i]->view(sectionData<Real>(*file, header.trianglesOffset[i]), header.numFaces, file);
+    }
+    normals.view(sectionData<Vector3r>(*file, header.normalsOffset), header.numNormals, file);
+    octNormals.view(sectionData<uint32_t>(*file, header.octNormalsOffset), header.numOctNormals, file);
+    cornerNormals.view(sectionData<uint32_t>(*file, header.cornerNormalsOffset), 3*header.numFaces, file);
+    faceMaterials.view(sectionData<int>(*file, header.faceMaterialsOffset), header.numFaces, file);
+    return true;
+}
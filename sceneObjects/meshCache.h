@@ -0,0 +1,18 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <string>
+#include <cstdint>
+
+// Bump whenever the layout of a cached mesh changes
+#define MESH_CACHE_VERSION 3
+
+// Hash of everything a built mesh depends on: the contents of the model file, the
+// smoothing cutoff, how its normals are stored, the precision of this build and the
+// cache layout
+uint64_t meshSourceHash(const std::string &fileName, double smoothingCutoff, bool octNormals);
+std::string meshCachePath(const std::string &cacheDirectory, uint64_t sourceHash);
+
+uint64_t hashBytes(const char *data, size_t size, uint64_t hash = 14695981039346656037ULL);
+
+#endif
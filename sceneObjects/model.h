@@ -2,45 +2,53 @@
 #define MODEL_H
 
 #include "sceneObject.h"
-#include "../dataStructures/material.h"
-#include "../dataStructures/ray.h"
-#include "../dataStructures/face.h"
+#include "mesh.h"
 #include "transformation.h"
-#include <string>
-#include <iostream>
+#include "../dataStructures/ray.h"
+#include "../dataStructures/boundingBox.h"
+#include "../dataStructures/material.h"
+#include <memory>
 #include <vector>
-#include <map>
 #include <Eigen/Dense>
 
+// One placement of a Mesh in the scene. Rays are moved into the mesh's space instead of
+// moving the mesh, so any number of models can share the same geometry.
 class Model: public SceneObject {
     public:
         Model() = delete;
         Model(const Model &) = default;
-        Model(const std::string &modelLine);
+        Model(std::shared_ptr<const Mesh> mesh, const Transformation &transformation);
         virtual ~Model() = default;
+        // Fixed size Eigen matrices need aligned allocation when vectorized with AVX
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
-        std::vector<Material> materials;
-        void intersectRay(Ray &ray);
-        void intersectRayWithEarlyTermination(Ray &);
-        Ray getRefractionRay(Ray &);
-        void transform(Transformation &transform);
-        int numFaces = 0;
+        void intersectRay(Ray &ray) const;
+        Ray getRefractionRay(Ray &) const;
+        BoundingBox getBounds() const;
+        void intersectPacket(RayPacket &) const;
+        void resolveHit(Ray &) const;
+        bool occludes(const Ray &, int &primitive) const;
+        bool primitiveOccludes(const Ray &, int primitive) const;
+        bool attenuate(const Ray &, Vector3r &transmission) const;
+        const Mesh &getMesh() const { return *mesh; }
+        // Moves the model by motion from where its transformation placed it
+        void place(const Matrix4r &motion);
+        // The materials of the model's faces: the mesh's, until setMaterial gives the model
+        // its own copy, which leaves other models of the same mesh alone
+        const std::vector<Material> &getMaterials() const;
+        // Throws a string if the mesh has no material index
+        void setMaterial(int index, const Material &material);
 
     private:
-        double smoothingCutoff;
-        int currentMaterial = -1;
-        Eigen::Matrix<double, 4, Eigen::Dynamic> vertices;
-        std::vector<std::vector<int>> vertexFaceRef;
-        std::vector<Eigen::Vector3i> normals;
-        std::vector<Face> faces;
-        void buildFromWavefrontObjectFile(const std::string &fileName);
-        void convertVectorsToMatrix(const std::vector<Eigen::Vector3d> &verts);
-        void convertWavefrontObjectFileToVector(const std::string &fileName, std::vector<Eigen::Vector3d> &vertices);
-        void processNewFace(const std::string &line);
-        void processNewMaterials(const std::string &line);
-        void processUseMaterial(const std::string &line);
-        void faceIntersectRay(const Face &, Ray &);
-        void calculateSurfaceNormals();
+        std::shared_ptr<const Mesh> mesh;
+        // Empty while the model uses the mesh's materials
+        std::vector<Material> ownMaterials;
+        Matrix4r placement;
+        Matrix4r toWorld;
+        Matrix4r toMesh;
+        Matrix3r normalToWorld;
+        Ray rayToMeshSpace(const Ray &ray) const;
+        void copyHit(const Ray &meshRay, Ray &ray) const;
 };
 
 #endif
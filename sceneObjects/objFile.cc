@@ -0,0 +1,293 @@
+#include "objFile.h"
+#include "../dataStructures/mappedFile.h"
+#include <Eigen/Dense>
+#include <string>
+#include <vector>
+#include <thread>
+#include <functional>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <climits>
+
+using namespace Eigen;
+using namespace std;
+
+// Files smaller than this are parsed by a single thread
+#define OBJ_PARALLEL_MIN_BYTES (1 << 20)
+
+// Everything read from one chunk of the file. Negative (relative) vertex indices can
+// point into earlier chunks, so they are resolved once all vertex counts are known.
+class ObjChunk {
+  public:
+    vector<Vector3r> vertices;
+    vector<Vector3i> triangles;
+    // Corners (3*triangle + corner) whose index counts from the start of this chunk
+    vector<size_t> relativeCorners;
+    vector<ObjMaterialStatement> materialStatements;
+    string error;
+};
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+void skipSpaces(const char *&pos, const char *end) {
+    while(pos < end && isSpace(*pos)) pos++;
+}
+
+const char *nextLine(const char *pos, const char *end) {
+    const char *newline = static_cast<const char *>(memchr(pos, '\n', end - pos));
+    return newline ? newline + 1 : end;
+}
+
+bool startsWithWord(const char *pos, const char *end, const char *word) {
+    size_t length = strlen(word);
+    return (size_t)(end - pos) > length && memcmp(pos, word, length) == 0 && isSpace(pos[length]);
+}
+
+// Exact powers of ten representable as doubles
+const double exactPowersOfTen[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+bool parseReal(const char *&pos, const char *end, double &value) {
+    const char *start = pos;
+    const char *cur = pos;
+    bool negative = false;
+    if(cur < end && (*cur == '-' || *cur == '+')) {
+        negative = *cur == '-';
+        cur++;
+    }
+    uint64_t mantissa = 0;
+    int significantDigits = 0;
+    int exponent = 0;
+    bool anyDigits = false;
+    bool truncated = false;
+    for(; cur < end && isDigit(*cur); cur++) {
+        anyDigits = true;
+        if(significantDigits < 19) {
+            mantissa = mantissa*10 + (*cur - '0');
+            if(mantissa) significantDigits++;
+        } else {
+            exponent++;
+            truncated = true;
+        }
+    }
+    if(cur < end && *cur == '.') {
+        for(cur++; cur < end && isDigit(*cur); cur++) {
+            anyDigits = true;
+            if(significantDigits < 19) {
+                mantissa = mantissa*10 + (*cur - '0');
+                if(mantissa) significantDigits++;
+                exponent--;
+            } else {
+                truncated = true;
+            }
+        }
+    }
+    if(!anyDigits) return false;
+    if(cur < end && (*cur == 'e' || *cur == 'E')) {
+        const char *exponentStart = cur++;
+        bool negativeExponent = false;
+        if(cur < end && (*cur == '-' || *cur == '+')) {
+            negativeExponent = *cur == '-';
+            cur++;
+        }
+        if(cur < end && isDigit(*cur)) {
+            int written = 0;
+            for(; cur < end && isDigit(*cur); cur++) {
+                if(written < 10000) written = written*10 + (*cur - '0');
+            }
+            exponent += negativeExponent ? -written : written;
+        } else {
+            cur = exponentStart;
+        }
+    }
+    pos = cur;
+    // Clinger's fast path: both the mantissa and the power of ten are exact doubles, so
+    // one correctly rounded multiplication or division gives the correctly rounded result
+    if(!truncated && mantissa <= (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22) {
+        value = exponent < 0 ? mantissa / exactPowersOfTen[-exponent] : mantissa * exactPowersOfTen[exponent];
+        if(negative) value = -value;
+        return true;
+    }
+    // strtod needs a terminated string, which the mapped file doesn't have
+    string number(start, cur);
+    value = strtod(number.c_str(), nullptr);
+    return true;
+}
+
+bool parseInt(const char *&pos, const char *end, long &value) {
+    const char *cur = pos;
+    bool negative = false;
+    if(cur < end && (*cur == '-' || *cur == '+')) {
+        negative = *cur == '-';
+        cur++;
+    }
+    if(cur == end || !isDigit(*cur)) return false;
+    long result = 0;
+    for(; cur < end && isDigit(*cur); cur++) {
+        result = result*10 + (*cur - '0');
+    }
+    value = negative ? -result : result;
+    pos = cur;
+    return true;
+}
+
+bool parseVertex(const char *pos, const char *end, ObjChunk &chunk) {
+    double coordinates[3];
+    for(int axis = 0; axis < 3; axis++) {
+        skipSpaces(pos, end);
+        if(!parseReal(pos, end, coordinates[axis])) return false;
+    }
+    chunk.vertices.emplace_back(coordinates[0], coordinates[1], coordinates[2]);
+    return true;
+}
+
+// Reads a v, v/vt, v//vn or v/vt/vn corner and keeps only the vertex index
+bool parseCorner(const char *&pos, const char *end, long &index) {
+    if(!parseInt(pos, end, index) || index == 0) return false;
+    while(pos < end && !isSpace(*pos) && *pos != '\n') pos++;
+    return true;
+}
+
+// Polygons with more than three corners are split into a fan of triangles around the first
+bool parseFace(const char *pos, const char *end, ObjChunk &chunk) {
+    long corners[3];
+    bool relative[3];
+    int numCorners = 0;
+    while(true) {
+        skipSpaces(pos, end);
+        if(pos == end || *pos == '\n' || *pos == '#') break;
+        long index;
+        if(!parseCorner(pos, end, index)) return false;
+        int slot = numCorners < 3 ? numCorners : 2;
+        if(numCorners >= 3) {
+            corners[1] = corners[2];
+            relative[1] = relative[2];
+        }
+        relative[slot] = index < 0;
+        corners[slot] = index < 0 ? (long)chunk.vertices.size() + index : index - 1;
+        // The mesh stores 32-bit indices, so an index beyond them can't name a vertex. -1
+        // makes readObjFile report it as missing.
+        if(corners[slot] < INT_MIN || corners[slot] > INT_MAX) {
+            corners[slot] = -1;
+            relative[slot] = false;
+        }
+        numCorners++;
+        if(numCorners >= 3) {
+            size_t triangle = chunk.triangles.size();
+            for(int corner = 0; corner < 3; corner++) {
+                if(relative[corner]) chunk.relativeCorners.push_back(3*triangle + corner);
+            }
+            chunk.triangles.emplace_back(int(corners[0]), int(corners[1]), int(corners[2]));
+        }
+    }
+    return numCorners >= 3;
+}
+
+string restOfLine(const char *pos, const char *end) {
+    skipSpaces(pos, end);
+    const char *lineEnd = pos;
+    while(lineEnd < end && *lineEnd != '\n') lineEnd++;
+    while(lineEnd > pos && isSpace(lineEnd[-1])) lineEnd--;
+    return string(pos, lineEnd);
+}
+
+void parseChunk(const char *pos, const char *end, ObjChunk &chunk) {
+    for(; pos < end; pos = nextLine(pos, end)) {
+        skipSpaces(pos, end);
+        if(pos == end) break;
+        bool valid = true;
+        if(*pos == 'v' && pos + 1 < end && isSpace(pos[1])) {
+            valid = parseVertex(pos + 1, end, chunk);
+        } else if(*pos == 'f' && pos + 1 < end && isSpace(pos[1])) {
+            valid = parseFace(pos + 1, end, chunk);
+        } else if(startsWithWord(pos, end, "mtllib") || startsWithWord(pos, end, "usemtl")) {
+            ObjMaterialStatement statement;
+            statement.firstTriangle = chunk.triangles.size();
+            statement.isLibrary = *pos == 'm';
+            statement.argument = restOfLine(pos + 6, end);
+            chunk.materialStatements.push_back(statement);
+        }
+        if(!valid) {
+            chunk.error = "Malformed line: " + restOfLine(pos, end);
+            return;
+        }
+    }
+}
+
+ObjFile readObjFile(const string &fileName) {
+    MappedFile file(fileName);
+
+    int numChunks = 1;
+    if(file.size() >= OBJ_PARALLEL_MIN_BYTES) {
+        numChunks = max(1u, thread::hardware_concurrency());
+    }
+    // Chunks start at the beginning of a line
+    vector<const char *> boundaries(1, file.begin());
+    for(int i = 1; i < numChunks; i++) {
+        const char *boundary = file.begin() + file.size()*i/numChunks;
+        boundary = max(boundaries.back(), nextLine(boundary - 1, file.end()));
+        boundaries.push_back(boundary);
+    }
+    boundaries.push_back(file.end());
+
+    vector<ObjChunk> chunks(numChunks);
+    vector<thread> parsers;
+    for(int i = 1; i < numChunks; i++) {
+        parsers.emplace_back(parseChunk, boundaries[i], boundaries[i + 1], ref(chunks[i]));
+    }
+    parseChunk(boundaries[0], boundaries[1], chunks[0]);
+    for(thread &parser: parsers) {
+        parser.join();
+    }
+
+    ObjFile obj;
+    size_t totalVertices = 0, totalTriangles = 0;
+    for(const ObjChunk &chunk: chunks) {
+        if(!chunk.error.empty()) {
+            throw ("Couldn't read model file (" + fileName + "). " + chunk.error);
+        }
+        totalVertices += chunk.vertices.size();
+        totalTriangles += chunk.triangles.size();
+    }
+    if(totalVertices > size_t(INT_MAX)) {
+        throw ("Model file (" + fileName + ") has more vertices than a mesh can index");
+    }
+    const string missingVertex = "Model file (" + fileName + ") refers to a vertex which doesn't exist";
+    obj.vertices.reserve(totalVertices);
+    obj.triangles.reserve(totalTriangles);
+    for(ObjChunk &chunk: chunks) {
+        int64_t vertexOffset = obj.vertices.size();
+        size_t triangleOffset = obj.triangles.size();
+        // Checked in 64 bits before narrowing, as a relative index may reach back before
+        // the first vertex
+        for(size_t corner: chunk.relativeCorners) {
+            int64_t index = chunk.triangles[corner/3](corner%3) + vertexOffset;
+            if(index < 0) throw missingVertex;
+            chunk.triangles[corner/3](corner%3) = index;
+        }
+        obj.vertices.insert(obj.vertices.end(), chunk.vertices.begin(), chunk.vertices.end());
+        obj.triangles.insert(obj.triangles.end(), chunk.triangles.begin(), chunk.triangles.end());
+        for(ObjMaterialStatement &statement: chunk.materialStatements) {
+            statement.firstTriangle += triangleOffset;
+            obj.materialStatements.push_back(statement);
+        }
+    }
+    for(const Vector3i &triangle: obj.triangles) {
+        for(int corner = 0; corner < 3; corner++) {
+            if(triangle(corner) < 0 || size_t(triangle(corner)) >= obj.vertices.size()) {
+                throw missingVertex;
+            }
+        }
+    }
+    return obj;
+}
@@ -0,0 +1,36 @@
+#ifndef OBJ_FILE_H
+#define OBJ_FILE_H
+
+#include "../dataStructures/precision.h"
+#include <Eigen/Dense>
+#include <string>
+#include <vector>
+#include <cstddef>
+
+// A mtllib or usemtl line, applying to the triangles from firstTriangle onwards
+class ObjMaterialStatement {
+  public:
+    size_t firstTriangle;
+    bool isLibrary;
+    std::string argument;
+};
+
+// Geometry of a Wavefront Object file. Polygons are split into triangles, and every
+// vertex index is resolved to a position in vertices.
+class ObjFile {
+  public:
+    std::vector<Vector3r> vertices;
+    std::vector<Eigen::Vector3i> triangles;
+    std::vector<ObjMaterialStatement> materialStatements;
+};
+
+// Maps the file into memory and parses it in place, splitting large files into chunks
+// which are parsed in parallel. Texture coordinates and normals are accepted but not
+// used. Throws a string if the file can't be read or refers to a missing vertex.
+ObjFile readObjFile(const std::string &fileName);
+
+// Parses a decimal number at pos and moves pos past it. Returns false, leaving pos
+// alone, if there is no number there.
+bool parseReal(const char *&pos, const char *end, double &value);
+
+#endif
@@ -6,14 +6,14 @@
 using namespace std;
 using namespace Eigen;
 
-Vector3d SceneObject::getRefractionDir(Vector3d rayDir, Vector3d normal, double etaFrom, double etaTo) {
-    double refracIndexRatio = etaFrom/etaTo;
-    double dotProd = rayDir.dot(normal);
-    double radicalSqrd = refracIndexRatio*refracIndexRatio*(dotProd*dotProd-1)+1;
+Vector3r SceneObject::getRefractionDir(Vector3r rayDir, Vector3r normal, Real etaFrom, Real etaTo) const {
+    Real refracIndexRatio = etaFrom/etaTo;
+    Real dotProd = rayDir.dot(normal);
+    Real radicalSqrd = refracIndexRatio*refracIndexRatio*(dotProd*dotProd-1)+1;
     if(radicalSqrd < 0.0001) {
          throw string("Refraction is not feasible");
     }
-    double normCoeff = (refracIndexRatio * dotProd) - sqrt(radicalSqrd);
-    Vector3d refractDir = (-refracIndexRatio)*rayDir + normCoeff*normal;
+    Real normCoeff = (refracIndexRatio * dotProd) - sqrt(radicalSqrd);
+    Vector3r refractDir = (-refracIndexRatio)*rayDir + normCoeff*normal;
     return refractDir;
 }
@@ -2,15 +2,31 @@
 #define SCENE_OBJ_H
 
 #include "../dataStructures/ray.h"
+#include "../dataStructures/boundingBox.h"
+#include "../dataStructures/rayPacket.h"
 
 class SceneObject {
   public:
-    virtual void intersectRay(Ray &) = 0;
-    virtual void intersectRayWithEarlyTermination(Ray &) = 0;
-    virtual Ray getRefractionRay(Ray &) = 0;
+    // All intersection queries are read-only so they may run concurrently on many threads
+    virtual void intersectRay(Ray &) const = 0;
+    virtual Ray getRefractionRay(Ray &) const = 0;
+    virtual BoundingBox getBounds() const = 0;
+    // Records closer hits in the packet's lanes
+    virtual void intersectPacket(RayPacket &) const = 0;
+    // Fills in the intersection point, normal and material of the hit recorded in the ray
+    virtual void resolveHit(Ray &) const = 0;
+    // Any-hit queries for shadow rays. They look for surfaces the ray crosses before
+    // ray.distanceToIntersect, stop as soon as the answer is known and record nothing.
+    // occludes also reports which primitive blocked the ray, so that primitiveOccludes can
+    // try it first for the next ray towards the same light
+    virtual bool occludes(const Ray &, int &primitive) const = 0;
+    virtual bool primitiveOccludes(const Ray &, int primitive) const = 0;
+    // Multiplies transmission by the transparency of every surface crossed, and returns
+    // true once no light gets through
+    virtual bool attenuate(const Ray &, Vector3r &transmission) const = 0;
     virtual ~SceneObject() = default;
   protected:
-    Eigen::Vector3d getRefractionDir(Eigen::Vector3d toLight, Eigen::Vector3d normal, double etaFrom, double etaTo);
+    Vector3r getRefractionDir(Vector3r toLight, Vector3r normal, Real etaFrom, Real etaTo) const;
 };
 
 #endif
@@ -1,39 +1,126 @@
 #include "sphere.h"
 #include "../dataStructures/ray.h"
+#include "../dataStructures/traversalCounters.h"
 #include <Eigen/Dense>
 #include <cmath>
 
 using namespace Eigen;
 
-void Sphere::intersectRay(Ray &ray) {
-    Vector3d origToCent = center - ray.origin;
-    double project = (origToCent).dot(ray.dir);
+bool Sphere::crossingDistances(const Vector3d &origin, const Vector3d &dir,
+                               double &nearDistance, double &farDistance) const {
+    traversalCounters().sphereTests++;
+    Vector3d origToCent = center - origin;
+    double project = (origToCent).dot(dir);
     double distToCentSqr = origToCent.dot(origToCent);
     double disc = radius*radius - (distToCentSqr - project*project);
-    if(disc < 0.0001) return;
+    if(disc < 0.0001) return false;
     double distFromProj = sqrt(disc);
-    double distFromOrig = project - distFromProj;
-    if(distFromOrig > 0 && (!ray.foundIntersect || (distFromOrig-0.001) < ray.distanceToIntersect)) {
+    nearDistance = project - distFromProj;
+    farDistance = project + distFromProj;
+    return true;
+}
+
+bool Sphere::hitDistance(const Vector3d &origin, const Vector3d &dir, double &distance) const {
+    double farDistance;
+    return crossingDistances(origin, dir, distance, farDistance) && distance > 0;
+}
+
+void Sphere::intersectRay(Ray &ray) const {
+    double distFromOrig;
+    if(!hitDistance(ray.origin.cast<double>(), ray.dir.cast<double>(), distFromOrig)) return;
+    if(!ray.foundIntersect || (distFromOrig-0.001) < ray.distanceToIntersect) {
         ray.distanceToIntersect = distFromOrig;
         ray.foundIntersect = true;
-        ray.intersect = ray.origin + ray.distanceToIntersect*ray.dir;
-        ray.surfaceNormal = ray.intersect - center;
-        ray.surfaceNormal = ray.surfaceNormal / ray.surfaceNormal.norm();
-        ray.material = material;
         ray.intersectObject = this;
+        ray.primitiveIndex = 0;
+    }
+}
+
+void Sphere::resolveHit(Ray &ray) const {
+    ray.intersect = ray.origin + ray.distanceToIntersect*ray.dir;
+    Vector3d normal = ray.intersect.cast<double>() - center;
+    ray.surfaceNormal = (normal / normal.norm()).cast<Real>();
+    ray.material = &material;
+}
+
+bool Sphere::occludes(const Ray &ray, int &primitive) const {
+    primitive = 0;
+    return primitiveOccludes(ray, 0);
+}
+
+bool Sphere::primitiveOccludes(const Ray &ray, int) const {
+    double distFromOrig;
+    return hitDistance(ray.origin.cast<double>(), ray.dir.cast<double>(), distFromOrig)
+        && (!ray.foundIntersect || (distFromOrig-0.001) < ray.distanceToIntersect);
+}
+
+bool Sphere::attenuate(const Ray &ray, Vector3r &transmission) const {
+    double crossings[2];
+    if(!crossingDistances(ray.origin.cast<double>(), ray.dir.cast<double>(), crossings[0], crossings[1])) {
+        return false;
+    }
+    for(double distFromOrig: crossings) {
+        if(distFromOrig > 0 && (!ray.foundIntersect || (distFromOrig-0.001) < ray.distanceToIntersect)) {
+            transmission = transmission.cwiseProduct(material.transparency);
+        }
+    }
+    return transmission == Vector3r(0,0,0);
+}
+
+void Sphere::intersectPacket(RayPacket &packet) const {
+#ifdef RAYTRACER_SINGLE_PRECISION
+    // Float lanes cannot hold the difference between a ray origin and a far away center,
+    // so test the lanes one by one in double precision
+    for(int lane = 0; lane < SIMD_WIDTH; lane++) {
+        Vector3d origin(packet.origin[0][lane], packet.origin[1][lane], packet.origin[2][lane]);
+        Vector3d dir(packet.dir[0][lane], packet.dir[1][lane], packet.dir[2][lane]);
+        double distFromOrig;
+        if(hitDistance(origin, dir, distFromOrig) && (distFromOrig - 0.001) < packet.distance[lane]) {
+            packet.distance[lane] = distFromOrig;
+            packet.hitObject[lane] = this;
+            packet.hitPrimitive[lane] = 0;
+        }
+    }
+#else
+    traversalCounters().sphereTests += SIMD_WIDTH;
+    SimdReal origToCent[3];
+    for(int axis = 0; axis < 3; axis++) {
+        origToCent[axis] = SimdReal(center(axis)) - packet.originAxis(axis);
     }
+    SimdReal project = origToCent[0]*packet.dirAxis(0) + origToCent[1]*packet.dirAxis(1) + origToCent[2]*packet.dirAxis(2);
+    SimdReal distToCentSqr = origToCent[0]*origToCent[0] + origToCent[1]*origToCent[1] + origToCent[2]*origToCent[2];
+    SimdReal disc = SimdReal(radius*radius) - (distToCentSqr - project*project);
+    SimdReal distFromOrig = project - sqrt(disc);
+    SimdMask hit = (disc >= SimdReal(0.0001)) & (distFromOrig > SimdReal(0.0))
+                 & ((distFromOrig - SimdReal(0.001)) < packet.distances());
+    int hits = hit.bits();
+    if(!hits) return;
+    alignas(SIMD_ALIGNMENT) Real hitDistance[SIMD_WIDTH];
+    distFromOrig.store(hitDistance);
+    for(int lane = 0; lane < SIMD_WIDTH; lane++) {
+        if(hits & (1 << lane)) {
+            packet.distance[lane] = hitDistance[lane];
+            packet.hitObject[lane] = this;
+            packet.hitPrimitive[lane] = 0;
+        }
+    }
+#endif
 }
 
-void Sphere::intersectRayWithEarlyTermination(Ray &ray) {
-    intersectRay(ray);
+
+BoundingBox Sphere::getBounds() const {
+    BoundingBox bounds;
+    bounds.extend((center - Vector3d::Constant(radius)).cast<Real>());
+    bounds.extend((center + Vector3d::Constant(radius)).cast<Real>());
+    return bounds;
 }
 
-Ray Sphere::getRefractionRay(Ray &ray) {
-    Vector3d refractionDir = getRefractionDir(-ray.dir, ray.surfaceNormal, 1.0, ray.material.refractiveIndex);
-    Vector3d exitPt = ray.intersect + 2*refractionDir.dot(center-ray.intersect)*refractionDir;
-    Vector3d exitNorm = (this->center - exitPt);
+Ray Sphere::getRefractionRay(Ray &ray) const {
+    Vector3r refractionDir = getRefractionDir(-ray.dir, ray.surfaceNormal, 1.0, material.refractiveIndex);
+    Vector3r exitPt = ray.intersect + 2*refractionDir.dot(center.cast<Real>()-ray.intersect)*refractionDir;
+    Vector3r exitNorm = (center.cast<Real>() - exitPt);
     exitNorm = exitNorm / exitNorm.norm();
-    Vector3d exitDir = getRefractionDir(-refractionDir, exitNorm, ray.material.refractiveIndex, 1.0);
+    Vector3r exitDir = getRefractionDir(-refractionDir, exitNorm, material.refractiveIndex, 1.0);
     Ray exitRay;
     exitRay.dir = refractionDir;
     exitRay.dir = exitDir;
@@ -8,14 +8,28 @@
 
 class Sphere: public SceneObject {
   public:
+    // Kept in double precision even in single precision builds: scenes use spheres
+    // with radii around 1e10 as walls, which floats cannot place to within a unit
     Eigen::Vector3d center;
     double radius;
     Material material;
-    void intersectRay(Ray &);
-    void intersectRayWithEarlyTermination(Ray &);
-    Ray getRefractionRay(Ray &);
+    void intersectRay(Ray &) const;
+    Ray getRefractionRay(Ray &) const;
+    BoundingBox getBounds() const;
+    void intersectPacket(RayPacket &) const;
+    void resolveHit(Ray &) const;
+    bool occludes(const Ray &, int &primitive) const;
+    bool primitiveOccludes(const Ray &, int primitive) const;
+    bool attenuate(const Ray &, Vector3r &transmission) const;
 
     virtual ~Sphere() = default;
+
+  private:
+    // Distance along dir to the first crossing of the surface in front of origin
+    bool hitDistance(const Eigen::Vector3d &origin, const Eigen::Vector3d &dir, double &distance) const;
+    // Distances to both crossings of the surface, which may be behind origin
+    bool crossingDistances(const Eigen::Vector3d &origin, const Eigen::Vector3d &dir,
+                           double &nearDistance, double &farDistance) const;
 };
 
 #endif
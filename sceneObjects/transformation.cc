@@ -33,18 +33,23 @@ Transformation::Transformation(const string &driverLine) {
     buildTransformationMatrix();
 }
 
-Matrix4d getAxisRotationMatrix(double wx, double wy, double wz) {
-    Vector3d zAxis(wx, wy, wz);
+Transformation::Transformation(double wx, double wy, double wz, double theta, double scale, double tx, double ty, double tz)
+    : wx(wx), wy(wy), wz(wz), theta(theta), scale(scale), tx(tx), ty(ty), tz(tz) {
+    buildTransformationMatrix();
+}
+
+Matrix4r getAxisRotationMatrix(double wx, double wy, double wz) {
+    Vector3r zAxis(wx, wy, wz);
     zAxis = zAxis/zAxis.norm();
-    Vector3d nonParallelVector(zAxis);
+    Vector3r nonParallelVector(zAxis);
     if(nonParallelVector(0) == 1)
         nonParallelVector(1) = 1;
     else
         nonParallelVector(0) = 1;
-    Vector3d xAxis = zAxis.cross(nonParallelVector);
+    Vector3r xAxis = zAxis.cross(nonParallelVector);
     xAxis = xAxis/xAxis.norm();
-    Vector3d yAxis = zAxis.cross(xAxis);
-    Matrix4d rotationMatrix;
+    Vector3r yAxis = zAxis.cross(xAxis);
+    Matrix4r rotationMatrix;
     rotationMatrix << xAxis(0), xAxis(1), xAxis(2), 0,
                       yAxis(0), yAxis(1), yAxis(2), 0,
                       zAxis(0), zAxis(1), zAxis(2), 0,
@@ -52,9 +57,9 @@ Matrix4d getAxisRotationMatrix(double wx, double wy, double wz) {
     return rotationMatrix;
 }
 
-Matrix4d getAngleRotationMatrix(double theta) {
+Matrix4r getAngleRotationMatrix(double theta) {
     double radians = theta*PI/180;
-    Matrix4d rotationMatrix;
+    Matrix4r rotationMatrix;
     double acos = cos(radians);
     double asin = sin(radians);
     rotationMatrix << acos, -asin, 0, 0,
@@ -64,16 +69,16 @@ Matrix4d getAngleRotationMatrix(double theta) {
     return rotationMatrix;
 }
 
-Matrix4d getAxisAngleRotationMatrix(double wx, double wy, double wz, double theta) {
-    Matrix4d rotateAxisToZ = getAxisRotationMatrix(wx, wy, wz);
-    Matrix4d rotateAboutZ = getAngleRotationMatrix(theta);
-    Matrix4d rotateAxisToZTranspose = rotateAxisToZ.transpose();
-    Matrix4d AxisAngleRotationMatrix = rotateAxisToZTranspose * rotateAboutZ * rotateAxisToZ;
+Matrix4r getAxisAngleRotationMatrix(double wx, double wy, double wz, double theta) {
+    Matrix4r rotateAxisToZ = getAxisRotationMatrix(wx, wy, wz);
+    Matrix4r rotateAboutZ = getAngleRotationMatrix(theta);
+    Matrix4r rotateAxisToZTranspose = rotateAxisToZ.transpose();
+    Matrix4r AxisAngleRotationMatrix = rotateAxisToZTranspose * rotateAboutZ * rotateAxisToZ;
     return AxisAngleRotationMatrix;
 }
 
-Matrix4d getUniformScalingMatrix(double scale) {
-    Matrix4d scaling;
+Matrix4r getUniformScalingMatrix(double scale) {
+    Matrix4r scaling;
     scaling << scale, 0, 0, 0,
                0, scale, 0, 0,
                0, 0, scale, 0,
@@ -81,8 +86,8 @@ Matrix4d getUniformScalingMatrix(double scale) {
     return scaling;
 }
 
-Matrix4d getTranslationMatrix(double tx, double ty, double tz) {
-    Matrix4d translate;
+Matrix4r getTranslationMatrix(double tx, double ty, double tz) {
+    Matrix4r translate;
     translate << 1, 0, 0, tx,
                  0, 1, 0, ty,
                  0, 0, 1, tz,
@@ -91,13 +96,13 @@ Matrix4d getTranslationMatrix(double tx, double ty, double tz) {
 }
 
 void Transformation::buildTransformationMatrix() {
-    Matrix4d rotation    = getAxisAngleRotationMatrix(wx, wy, wz, theta);
-    Matrix4d scaling     = getUniformScalingMatrix(scale);
-    Matrix4d translate   = getTranslationMatrix(tx, ty, tz);
+    Matrix4r rotation    = getAxisAngleRotationMatrix(wx, wy, wz, theta);
+    Matrix4r scaling     = getUniformScalingMatrix(scale);
+    Matrix4r translate   = getTranslationMatrix(tx, ty, tz);
     transformationMatrix = translate * scaling * rotation;
 }
 
-Matrix4d Transformation::getTransformationMatrix() {
+Matrix4r Transformation::getTransformationMatrix() const {
     return transformationMatrix;
 }
 
@@ -4,6 +4,7 @@
 #include <iostream>
 #include <string>
 #include <Eigen/Dense>
+#include "../dataStructures/precision.h"
 #include <iomanip>
 
 class Transformation {
@@ -12,8 +13,10 @@ class Transformation {
        Transformation(const Transformation &) = default;
        // Driver line beginning with "model" and ending with file to be transformed
        Transformation(const std::string &driverLine);
+       // Rotation of theta degrees about the axis, then uniform scaling, then translation
+       Transformation(double wx, double wy, double wz, double theta, double scale, double tx, double ty, double tz);
        
-       Eigen::Matrix4d getTransformationMatrix();
+       Matrix4r getTransformationMatrix() const;
 
        // Axis of rotation
        double wx, wy, wz;
@@ -26,7 +29,7 @@ class Transformation {
 
     private:
        void buildTransformationMatrix();
-       Eigen::Matrix4d transformationMatrix;
+       Matrix4r transformationMatrix;
 };
 
 #endif
@@ -0,0 +1,57 @@
+// Checks that a mesh built with a cache directory is mapped from the cache by the next
+// run, and renders the same materials. The model uses two material libraries whose paths
+// aren't a multiple of 8 characters long, so the records after them need padding.
+#include "../sceneObjects/mesh.h"
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <cstdlib>
+#include <unistd.h>
+
+using namespace std;
+
+void writeFile(const string &fileName, const string &contents) {
+    ofstream file(fileName);
+    file << contents;
+    if(!file) {
+        throw string("Couldn't write " + fileName);
+    }
+}
+
+bool sameMaterials(const Mesh &built, const Mesh &cached) {
+    if(built.materials.size() != cached.materials.size()) return false;
+    for(size_t i = 0; i < built.materials.size(); i++) {
+        if(built.materials[i].diffuse != cached.materials[i].diffuse) return false;
+    }
+    for(int face = 0; face < built.numFaces; face++) {
+        if(built.faceMaterial(face).diffuse != cached.faceMaterial(face).diffuse) return false;
+    }
+    return true;
+}
+
+int main() {
+    char directory[] = "/tmp/meshCacheCheck.XXXXXX";
+    if(!mkdtemp(directory) || chdir(directory) != 0) {
+        cerr << "meshCacheCheck: couldn't make a temporary directory\n";
+        return 1;
+    }
+    try {
+        writeFile("a.mtl", "newmtl red\nKd 0.9 0.1 0.1\n");
+        writeFile("bb.mtl", "newmtl green\nKd 0.1 0.9 0.1\n");
+        writeFile("quad.obj", "mtllib a.mtl\nmtllib bb.mtl\n"
+                              "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\n"
+                              "usemtl red\nf 1 2 3\nusemtl green\nf 1 3 4\n");
+        MeshOptions options;
+        options.cacheDirectory = "cache";
+        Mesh built("quad.obj", 0.5, options);
+        Mesh cached("quad.obj", 0.5, options);
+        bool passed = !built.loadedFromCache && cached.loadedFromCache && sameMaterials(built, cached);
+        system(("rm -rf " + string(directory)).c_str());
+        cout << "meshCacheCheck: mesh with two material libraries "
+             << (passed ? "loaded back from the cache\n" : "was not loaded back from the cache\n");
+        return passed ? 0 : 1;
+    } catch(string s) {
+        cerr << "meshCacheCheck: " << s << '\n';
+        return 1;
+    }
+}
@@ -0,0 +1,136 @@
+// Checks that a scene edited with SceneEditor::processEditLine, and rendered again only
+// where the edits could have changed it, is the same image as a fresh render of the scene
+// the edits describe. Material, light and move edits are checked one after another, each
+// against its own fresh render of the example scene.
+#include "../environment/environment.h"
+#include "../renderer/sceneEditor.h"
+#include "../renderer/parallelRenderer.h"
+#include "../renderer/renderOptions.h"
+#include "../renderer/framebuffer.h"
+#include "../sceneObjects/model.h"
+#include "../dataStructures/material.h"
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+using namespace std;
+
+const char *const EXAMPLE_DRIVER = "example/example.txt";
+
+vector<string> readLines(const string &fileName) {
+    ifstream file(fileName);
+    if(!file) {
+        throw string("Couldn't read " + fileName);
+    }
+    vector<string> lines;
+    string line;
+    while(getline(file, line)) {
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+// Replaces the line starting with prefix, or the count-th one of them
+void replaceLine(vector<string> &lines, const string &prefix, const string &replacement, int count = 0) {
+    for(string &line: lines) {
+        if(line.compare(0, prefix.size(), prefix) == 0 && count-- == 0) {
+            line = replacement;
+            return;
+        }
+    }
+    throw string("No line starting with " + prefix);
+}
+
+void writeLines(const string &fileName, const vector<string> &lines) {
+    ofstream file(fileName);
+    for(const string &line: lines) {
+        file << line << '\n';
+    }
+    if(!file) {
+        throw string("Couldn't write " + fileName);
+    }
+}
+
+bool sameImage(const Framebuffer &a, const Framebuffer &b) {
+    if(a.width != b.width || a.height != b.height) return false;
+    for(long y = 0; y < a.height; y++) {
+        if(memcmp(a.row(y), b.row(y), 3*a.width*sizeof(float)) != 0) return false;
+    }
+    return true;
+}
+
+// The example's checker model with its second material turned red, as the edit does
+const char *const MODEL_EDIT = "modelmaterial 0 Material.002 Kd 0.9 0.1 0.1";
+
+Framebuffer freshRender(const string &driverFile, const vector<string> &lines, const RenderOptions &options) {
+    writeLines(driverFile, lines);
+    Environment env(driverFile);
+    Model &model = dynamic_cast<Model &>(*env.sceneObjects[0]);
+    Material material = model.getMaterials()[1];
+    applyMaterialStatement(material, "Kd 0.9 0.1 0.1");
+    model.setMaterial(1, material);
+    Framebuffer image;
+    ParallelRenderer renderer(env, options);
+    renderer.render(image, [](double) {});
+    return image;
+}
+
+int main() {
+    char directory[] = "/tmp/sceneEditorCheck.XXXXXX";
+    if(!mkdtemp(directory)) {
+        cerr << "sceneEditorCheck: couldn't make a temporary directory\n";
+        return 1;
+    }
+    const string driverFile = string(directory) + "/driver.txt";
+    bool passed = true;
+    try {
+        vector<string> lines = readLines(EXAMPLE_DRIVER);
+        replaceLine(lines, "res ", "res 96 96");
+        writeLines(driverFile, lines);
+
+        RenderOptions options;
+        // The editor renders one ray a pixel, never in packets
+        options.usePackets = false;
+        Environment env(driverFile);
+        SceneEditor editor(env, options);
+        Framebuffer edited;
+        editor.render(edited);
+
+        struct Step {
+            const char *name;
+            vector<string> edits;
+        };
+        vector<Step> steps = {
+            {"materials", {"spherematerial 5 Kd 0.2 0.2 0.9", MODEL_EDIT}},
+            {"light", {"setlight 0 0.5 4 0.5 1 0.2 0.1 0.1"}},
+            {"move", {"movesphere 6 2 -3.75 1.5 1.25"}},
+        };
+        for(const Step &step: steps) {
+            for(const string &edit: step.edits) {
+                editor.processEditLine(edit);
+            }
+            editor.render(edited);
+            if(step.name == string("materials")) {
+                replaceLine(lines, "sphere ", "sphere 3 -3.75 -2 1.25 0.1 0.1 0.1 0.2 0.2 0.9 0.9 0.9 0.9 0.9 0.9 0.9 0", 4);
+            } else if(step.name == string("light")) {
+                replaceLine(lines, "light ", "light 0.5 4 0.5 1 0.2 0.1 0.1");
+            } else {
+                replaceLine(lines, "sphere ", "sphere 2 -3.75 1.5 1.25 0.0 0.0 0.0 0.0 0.0 0.0 0.0 0.0 0.0 0.0 0.0 0.0 2", 5);
+            }
+            bool same = sameImage(edited, freshRender(driverFile, lines, options));
+            cout << "sceneEditorCheck: " << step.name << " edit rendered " << editor.pixelsRendered << " pixels, "
+                 << (same ? "same as a fresh render\n" : "different from a fresh render\n");
+            passed = passed && same;
+        }
+    } catch(string s) {
+        cerr << "sceneEditorCheck: " << s << '\n';
+        passed = false;
+    }
+    system(("rm -rf " + string(directory)).c_str());
+    return passed ? 0 : 1;
+}